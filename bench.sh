@@ -0,0 +1,404 @@
+#!/bin/bash
+#
+#  Benchmark of dijkstra: generate graphs with genGraph, run dijkstra -T on them with
+#  different numbers of threads (and MPI processes), and write the time of each phase
+#  (parse, setup, solve, gather, output; see dijkstra -T) with the speedup and the
+#  efficiency of the solve phase, as CSV or JSON.
+#
+#  Strong scaling (the default): the same graph for every number of cores;
+#      speedup = solve time with the fewest cores / solve time
+#      efficiency = speedup * (fewest cores) / cores
+#  Weak scaling (-w): the number of vertices grows with the square root of the number
+#  of cores (the work of the dense engines is NV*NV), so the work per core is the same;
+#      efficiency = solve time with the fewest cores / solve time
+#  (cores = processes * threads)
+#
+#  Regression suite (-R): run each engine on each family of genGraph graphs (and on
+#  graph4.txt and graph6.txt) with each number of processes and threads, and check that
+#  its output is the same as that of the reference: the original sequential program,
+#  dijkstra.c of the first commit (git show; without git, the same file checked in as
+#  dijkstra_base.c), so it shares no code with the engines. It reads the graph as text;
+#  for floyd (-A) it runs once from each source, on the graph with that vertex and
+#  vertex 0 swapped. The engines on the dense matrix read the graph in dense form, the
+#  others in CSR form; bidir and alt get the destination nv-1 and floyd runs only on
+#  graphs of at most 500 vertices. For each case
+#  it writes the edges relaxed per second:
+#      edges / solve time   (edges: NV*NV for the dense engines, NV*NV*NV for floyd,
+#                            the edges of the graph for the CSR engines)
+#  and compares it with the baseline file (-b): a case at least -p percent slower is a
+#  regression (cases that ran in less than 1 ms are only checked for their output).
+#  The exit status is 1 if any output is wrong or any case is a regression.
+#  -U writes the results as the new baseline instead.
+#
+#  Usage: ./bench.sh [options]
+#    -n "nv ..."    numbers of vertices (default "2000 4000"; with -w: for the fewest cores)
+#    -t family      genGraph -t: uniform, er, rmat, grid or components (default uniform;
+#                   with -R a list, default all of them)
+#    -d density     genGraph -d
+#    -k degree      genGraph -k
+#    -m max-weight  genGraph max-weight (default 10)
+#    -S seed        genGraph seed (default 1)
+#    -e engine      dijkstra -e (default scan; with -R a list, default all the engines)
+#    -x "args"      more arguments for dijkstra (for example -x -s, or a destination)
+#    -T "t ..."     numbers of threads (default 1 2 4 ... up to the number of CPUs)
+#    -P "p ..."     numbers of MPI processes (default 1; more needs mpicc and mpirun)
+#    -r runs        runs of each case; the one with the fastest solve is kept (default 3)
+#    -w             weak scaling
+#    -f csv|json    output format (default csv)
+#    -o file        write the results to 'file' (default: the standard output)
+#    -B dir         where the programs and the graph files are kept (default bench_build)
+#    -R             regression suite
+#    -b file        (-R) the baseline (default: BUILD/baseline.csv)
+#    -p percent     (-R) a regression is a slowdown of at least this much (default 20)
+#    -U             (-R) write the baseline
+#  Environment: CC (default cc), MPICC (default mpicc), CFLAGS (default -O2),
+#               MPIRUN (default mpirun; for example MPIRUN="mpirun --oversubscribe"),
+#               REF_REV (-R: the commit of the reference; default the first one)
+#
+#  example: ./bench.sh -n 8000 -T "1 2 4 8" -e fused -f json -o fused.json
+#           ./bench.sh -R -n 1000 -T "1 4" -U     (once, on the machine of the baseline)
+#           ./bench.sh -R -n 1000 -T "1 4"        (after each change)
+
+NVS="2000 4000"
+FAMILY=
+DENSITY=
+DEGREE=
+MAXW=10
+SEED=1
+ENGINE=
+EXTRA=
+THREADS=
+PROCS=1
+RUNS=3
+WEAK=0
+FORMAT=csv
+OUT=
+BUILD=bench_build
+SUITE=0
+BASELINE=
+SLOWER=20
+UPDATE=0
+
+usage() {
+    sed -n '/^#  Usage/,/^#  example/p' "$0" | sed 's/^#//' >&2
+    exit 3
+}
+
+while getopts "n:t:d:k:m:S:e:x:T:P:r:wf:o:B:Rb:p:U" opt; do
+    case $opt in
+    n) NVS=$OPTARG ;;
+    t) FAMILY=$OPTARG ;;
+    d) DENSITY=$OPTARG ;;
+    k) DEGREE=$OPTARG ;;
+    m) MAXW=$OPTARG ;;
+    S) SEED=$OPTARG ;;
+    e) ENGINE=$OPTARG ;;
+    x) EXTRA=$OPTARG ;;
+    T) THREADS=$OPTARG ;;
+    P) PROCS=$OPTARG ;;
+    r) RUNS=$OPTARG ;;
+    w) WEAK=1 ;;
+    f) FORMAT=$OPTARG ;;
+    o) OUT=$OPTARG ;;
+    B) BUILD=$OPTARG ;;
+    R) SUITE=1 ;;
+    b) BASELINE=$OPTARG ;;
+    p) SLOWER=$OPTARG ;;
+    U) UPDATE=1 ;;
+    *) usage ;;
+    esac
+done
+[ "$FORMAT" = csv ] || [ "$FORMAT" = json ] || usage
+if [ $SUITE = 1 ]; then
+    FAMILY=${FAMILY:-uniform er rmat grid components}
+    ENGINE=${ENGINE:-scan fused bulk gpu floyd heap pairing radix delta bidir alt}
+    BASELINE=${BASELINE:-$BUILD/baseline.csv}
+fi
+FAMILY=${FAMILY:-uniform}
+ENGINE=${ENGINE:-scan}
+
+if [ -z "$THREADS" ]; then
+    cpus=$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)
+    THREADS=1
+    t=2
+    while [ $t -le "$cpus" ]; do THREADS="$THREADS $t"; t=$((2*t)); done
+fi
+
+SRC=$(cd "$(dirname "$0")" && pwd)
+CC=${CC:-cc}
+MPICC=${MPICC:-mpicc}
+MPIRUN=${MPIRUN:-mpirun}
+CFLAGS=${CFLAGS:--O2}
+mkdir -p "$BUILD" || exit 1
+
+# build the programs
+need_mpi=0
+for p in $PROCS; do [ "$p" -gt 1 ] && need_mpi=1; done
+$CC $CFLAGS -fopenmp "$SRC/genGraph.c" -o "$BUILD/genGraph" || exit 1
+if [ $need_mpi = 1 ]; then
+    $MPICC $CFLAGS -fopenmp -DUSE_MPI "$SRC/dijkstra.c" -o "$BUILD/dijkstra" || exit 1
+else
+    $CC $CFLAGS -fopenmp "$SRC/dijkstra.c" -o "$BUILD/dijkstra" || exit 1
+fi
+
+# fewest cores: the cores of the baseline
+min() { echo "$@" | tr ' ' '\n' | sort -n | head -1; }
+base_cores=$(( $(min $PROCS) * $(min $THREADS) ))
+
+# the graph file with $1 vertices (generated once) of the family $2 (default $FAMILY),
+# in the form $3: dense, csr or text (default: dense for uniform, csr for the others)
+graph() {
+    local family=${2:-$FAMILY} form=$3
+    [ -n "$form" ] || { [ "$family" = uniform ] && form=dense || form=csr; }
+    local f="$BUILD/graph-$family-$form-$1-$MAXW-$SEED${DENSITY:+-d$DENSITY}${DEGREE:+-k$DEGREE}.bin"
+    local format=-b
+    case $form in
+    csr)  format="-b -s" ;;
+    text) format=; f=${f%.bin}.txt ;;
+    esac
+    if [ ! -f "$f" ]; then
+        "$BUILD/genGraph" $format -t $family ${DENSITY:+-d $DENSITY} ${DEGREE:+-k $DEGREE} \
+                          -o "$f" "$1" "$MAXW" "$SEED" || exit 1
+    fi
+    echo "$f"
+}
+
+# one case: $1 vertices (for the baseline), $2 processes, $3 threads.
+# writes: base-nv nv procs threads parse setup solve gather output
+run_case() {
+    local nv=$1 p=$2 t=$3
+    if [ $WEAK = 1 ]; then
+        nv=$(awk -v n=$1 -v c=$((p*t)) -v b=$base_cores 'BEGIN { printf "%d", n*sqrt(c/b) + 0.5 }')
+    fi
+    local g=$(graph $nv)
+    local best=
+    for r in $(seq "$RUNS"); do
+        local cmd="$BUILD/dijkstra"
+        [ $need_mpi = 1 ] && cmd="$MPIRUN -np $p $cmd"
+        local line=$(OMP_NUM_THREADS=$t $cmd -T -e $ENGINE $EXTRA < "$g" 2>&1 >/dev/null | grep '^time ')
+        if [ -z "$line" ]; then
+            echo "bench.sh: dijkstra failed (nv=$nv processes=$p threads=$t)" >&2
+            exit 1
+        fi
+        local solve=$(echo "$line" | sed 's/.*solve=\([0-9.]*\).*/\1/')
+        if [ -z "$best" ] || awk -v a=$solve -v b=$best_solve 'BEGIN { exit !(a < b) }'; then
+            best=$line
+            best_solve=$solve
+        fi
+    done
+    echo "$1 $nv $p $t $(echo "$best" | sed 's/^time //; s/[a-z]*=//g')"
+}
+
+# the number of edges of the graph file $1: from the header of a binary CSR file,
+# otherwise the weights that are not '*' (a text file)
+num_edges() {
+    case $1 in
+    *.bin) od -An -tu8 -j16 -N8 "$1" | tr -d ' ' ;;
+    *)     awk 'NR == 1 { $1 = "*" } { for (i = 1; i <= NF; i++) n += $i != "*" } END { print n }' "$1" ;;
+    esac
+}
+
+# -R: build the reference, dijkstra.c of the commit REF_REV (default: the first commit)
+reference() {
+    local rev=${REF_REV:-$(git -C "$SRC" rev-list --max-parents=0 HEAD 2>/dev/null | tail -1)}
+    if [ -z "$rev" ] || ! git -C "$SRC" show "$rev:dijkstra.c" > "$BUILD/dijkstra_base.c" 2>/dev/null; then
+        cp "$SRC/dijkstra_base.c" "$BUILD/dijkstra_base.c" || exit 1
+    fi
+    $CC $CFLAGS "$BUILD/dijkstra_base.c" -o "$BUILD/dijkstra_ref" || exit 1
+}
+
+# -R: the output of dijkstra -A for the text graph file $1, with the reference:
+# for each source s, the distances from vertex 0 of the graph with s and 0 swapped
+reference_all_pairs() {
+    awk -v ref="$BUILD/dijkstra_ref" -v tmp="$BUILD/ref.out" '
+    { for (i = 1; i <= NF; i++) w[k++] = $i }
+    END {
+        n = w[0]
+        for (s = 0; s < n; s++) {
+            cmd = ref " > " tmp
+            print n | cmd
+            for (i = 0; i < n; i++) {
+                row = ""
+                pi = i == 0 ? s : i == s ? 0 : i
+                for (j = 0; j < n; j++)
+                    row = row " " w[1 + pi*n + (j == 0 ? s : j == s ? 0 : j)]
+                print row | cmd
+            }
+            if (close(cmd) != 0)
+                exit 1
+            print "distances from vertex " s ":"
+            while ((getline line < tmp) > 0) {
+                split(line, f, ":")
+                d[f[1]] = f[2]
+            }
+            close(tmp)
+            for (u = 0; u < n; u++)
+                print u ":" d[u == 0 ? s : u == s ? 0 : u]
+        }
+    }' "$1"
+}
+
+# -R: one line for each case:
+#   graph nv engine procs threads check solve edges
+# check is ok, wrong (not the output of the reference) or error (dijkstra failed)
+suite_cases() {
+    reference
+    local graphs= family nv
+    for family in $FAMILY; do
+        for nv in $NVS; do graphs="$graphs $family:$nv"; done
+    done
+    for g in $graphs graph4 graph6; do
+        local name dense csr text
+        case $g in
+        *:*) nv=${g#*:}; name=${g%:*}-$nv
+             dense=$(graph $nv ${g%:*} dense) || exit 1
+             csr=$(graph $nv ${g%:*} csr) || exit 1
+             text=$(graph $nv ${g%:*} text) || exit 1 ;;
+        *)   name=$g; dense="$SRC/$g.txt"; csr=$dense; text=$dense
+             nv=$(awk '{ print $1; exit }' "$dense") ;;
+        esac
+        for e in $ENGINE; do
+            local f=$dense args= edges=$((nv*nv)) one_process=0
+            case $e in
+            heap|pairing|radix|delta|bidir|alt) f=$csr; edges=$(num_edges "$csr") ;;
+            esac
+            case $e in
+            bidir|alt) args=$((nv-1)) ;;
+            floyd)     [ $nv -le 500 ] || continue; args=-A; edges=$((nv*nv*nv)) ;;
+            esac
+            case $e in heap|pairing|radix|delta|bidir|alt) one_process=1 ;; esac
+            # the output of the reference (found once)
+            local ref="$BUILD/$name.base$args"
+            if [ ! -f "$ref" ]; then
+                if [ $e = floyd ]; then
+                    reference_all_pairs "$text" > "$ref"
+                else
+                    "$BUILD/dijkstra_ref" $args < "$text" > "$ref"
+                fi || { rm -f "$ref"; exit 1; }
+            fi
+            [ $e = floyd ] && args=
+            for p in $PROCS; do
+                [ $p -gt 1 ] && [ $one_process = 1 ] && continue
+                for t in $THREADS; do
+                    local cmd="$BUILD/dijkstra" check=ok best=
+                    [ $need_mpi = 1 ] && cmd="$MPIRUN -np $p $cmd"
+                    for r in $(seq "$RUNS"); do
+                        OMP_NUM_THREADS=$t $cmd -T -e $e $EXTRA $args < "$f" > "$BUILD/out" 2> "$BUILD/err"
+                        local solve=$(grep '^time ' "$BUILD/err" | sed 's/.*solve=\([0-9.]*\).*/\1/')
+                        if [ -z "$solve" ]; then
+                            check=error
+                            break
+                        fi
+                        cmp -s "$BUILD/out" "$ref" || check=wrong
+                        if [ -z "$best" ] || awk -v a=$solve -v b=$best 'BEGIN { exit !(a < b) }'; then
+                            best=$solve
+                        fi
+                    done
+                    [ $check = error ] && echo "bench.sh: dijkstra -e $e failed on $name:" \
+                                               "$(head -1 "$BUILD/err")" >&2
+                    echo "$name $nv $e $p $t $check ${best:-0} $edges"
+                done
+            done
+        done
+    done
+}
+
+if [ $SUITE = 1 ]; then
+    results=$(suite_cases) || exit 1
+    [ -n "$OUT" ] && exec > "$OUT"
+    base_in=$BASELINE
+    [ -f "$BASELINE" ] && [ $UPDATE = 0 ] || base_in=/dev/null
+    # the edges per second, and the change from the baseline (graph,engine,processes,threads,eps)
+    echo "$results" | awk -v format=$FORMAT -v slower=$SLOWER -v update=$UPDATE -v baseline="$BASELINE" -v base_in="$base_in" '
+    BEGIN {
+        while ((getline l < base_in) > 0)
+            if (l !~ /^graph,/) { split(l, f, ","); base[f[1] " " f[2] " " f[3] " " f[4]] = f[5] }
+    }
+    { n++; line[n] = $0 }
+    END {
+        if (format == "csv")
+            print "graph,nv,engine,processes,threads,check,solve,edges,eps,baseline_eps,change,regression"
+        else
+            print "["
+        if (update)
+            print "graph,engine,processes,threads,eps" > baseline
+        for (i = 1; i <= n; i++) {
+            split(line[i], c, " ")
+            eps = c[7] > 0 ? c[8] / c[7] : 0
+            key = c[1] " " c[3] " " c[4] " " c[5]
+            b = (key in base) ? base[key] : 0
+            change = b > 0 ? eps / b - 1 : 0
+            slow = b > 0 && c[7] >= 0.001 && change <= -slower / 100
+            wrong += c[6] != "ok"
+            regressions += slow
+            if (update && c[6] == "ok")
+                printf "%s,%s,%d,%d,%.0f\n", c[1], c[3], c[4], c[5], eps > baseline
+            if (c[6] != "ok" || slow)
+                printf "bench.sh: %s: %s -e %s, %d processes, %d threads\n", c[6] != "ok" ? c[6] : "regression",
+                       c[1], c[3], c[4], c[5] > "/dev/stderr"
+            if (format == "csv")
+                printf "%s,%d,%s,%d,%d,%s,%s,%s,%.0f,%.0f,%.3f,%d\n", c[1], c[2], c[3], c[4], c[5], c[6],
+                       c[7], c[8], eps, b, change, slow
+            else
+                printf "  {\"graph\": \"%s\", \"nv\": %d, \"engine\": \"%s\", \"processes\": %d, " \
+                       "\"threads\": %d, \"check\": \"%s\", \"solve\": %s, \"edges\": %s, \"eps\": %.0f, " \
+                       "\"baseline_eps\": %.0f, \"change\": %.3f, \"regression\": %s}%s\n",
+                       c[1], c[2], c[3], c[4], c[5], c[6], c[7], c[8], eps, b, change,
+                       slow ? "true" : "false", i < n ? "," : ""
+        }
+        if (format == "json")
+            print "]"
+        printf "bench.sh: %d cases, %d wrong or failed, %d regressions%s\n", n, wrong, regressions,
+               update ? " (baseline written to " baseline ")" : "" > "/dev/stderr"
+        exit (wrong + regressions > 0)
+    }'
+    exit
+fi
+
+results=$(
+    for nv in $NVS; do
+        for p in $PROCS; do
+            for t in $THREADS; do
+                run_case $nv $p $t || exit 1
+            done
+        done
+    done
+) || exit 1
+
+[ -n "$OUT" ] && exec > "$OUT"
+
+# speedup and efficiency, relative to the case with the fewest cores (of the same base nv)
+echo "$results" | awk -v weak=$WEAK -v format=$FORMAT -v family=$FAMILY -v seed=$SEED -v engine=$ENGINE '
+{
+    n++; base[n] = $1; nv[n] = $2; procs[n] = $3; threads[n] = $4
+    for (k = 1; k <= 5; k++) phase[n, k] = $(4 + k)
+    cores = $3 * $4
+    if (!($1 in fewest) || cores < fewest[$1]) { fewest[$1] = cores; base_solve[$1] = $7 }
+}
+END {
+    mode = weak ? "weak" : "strong"
+    if (format == "csv")
+        print "mode,family,engine,seed,nv,processes,threads,parse,setup,solve,gather,output,total,speedup,efficiency"
+    else
+        print "["
+    for (i = 1; i <= n; i++) {
+        cores = procs[i] * threads[i]
+        total = 0
+        for (k = 1; k <= 5; k++) total += phase[i, k]
+        ratio = phase[i, 3] > 0 ? base_solve[base[i]] / phase[i, 3] : 0
+        if (weak) { efficiency = ratio; speedup = ratio * cores / fewest[base[i]] }
+        else      { speedup = ratio; efficiency = ratio * fewest[base[i]] / cores }
+        if (format == "csv")
+            printf "%s,%s,%s,%s,%d,%d,%d,%s,%s,%s,%s,%s,%.6f,%.3f,%.3f\n", mode, family, engine, seed,
+                   nv[i], procs[i], threads[i], phase[i, 1], phase[i, 2], phase[i, 3], phase[i, 4], phase[i, 5],
+                   total, speedup, efficiency
+        else
+            printf "  {\"mode\": \"%s\", \"family\": \"%s\", \"engine\": \"%s\", \"seed\": %s, \"nv\": %d, " \
+                   "\"processes\": %d, \"threads\": %d, \"parse\": %s, \"setup\": %s, \"solve\": %s, " \
+                   "\"gather\": %s, \"output\": %s, \"total\": %.6f, \"speedup\": %.3f, \"efficiency\": %.3f}%s\n",
+                   mode, family, engine, seed, nv[i], procs[i], threads[i], phase[i, 1], phase[i, 2],
+                   phase[i, 3], phase[i, 4], phase[i, 5], total, speedup, efficiency, i < n ? "," : ""
+    }
+    if (format == "json")
+        print "]"
+}'
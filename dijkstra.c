@@ -9,11 +9,200 @@
   In this case, the distance to this destination will be written
   to the standard output.  If there is no command line argument then the distances
   to all vertices will be written to the output.  
+
+  Options:
+    -e scan    each step makes two passes over the vertices: one finds the closest
+               vertex and one updates the distances (the default).
+    -e fused   each step makes one pass that updates the distances and
+               at the same time finds the closest vertex for the next step.
+    -e bulk    each step settles, at once, all the vertices whose distance is less than
+               the smallest distance + the smallest weight (their distances are final),
+               so there are far fewer steps (and MPI reductions) than vertices.
+               With MPI the vertices settled by the other processes are gathered with
+               MPI_Iallgatherv while the threads update the distances from our own
+               ones (see doWorkBulk()).
+    -e gpu     the steps of -e fused on an accelerator (GPU), with OpenMP target offload:
+               'edges' and 'distance' (with the DONE bits) stay in the memory of the device
+               and each step is one kernel that relaxes from the current vertex and finds
+               the closest one; only that vertex comes back (see doWorkGPU()). Compile
+               with an offloading compiler, for example  gcc -fopenmp -foffload=nvptx-none
+               or  clang -fopenmp --offload-arch=sm_80  (or amdgcn for AMD); otherwise
+               the steps run on the host. With MPI each process offloads its own columns.
+    -e heap    keep the vertices which are not done (but have a distance less than
+               INFINITY) in a binary heap instead of scanning all the vertices
+               to find the closest one.
+    -e pairing the same with a pairing heap.
+    -e radix   the same with a radix heap.
+               (heap, pairing and radix always store the graph in CSR form;
+               they are meant for sparse graphs and are not divided among
+               processes or threads.)
+    -e floyd   all pairs: the blocked (tiled) Floyd-Warshall algorithm on the dense
+               matrix, in place in 'edges' (if WEIGHT_BITS is 32). Implies -A (or use -m to choose the
+               rows that are written). The matrix is divided into FW_TILE x FW_TILE
+               tiles (compile with -DFW_TILE=n to change it); in round k the tile (k,k)
+               is done first, then the other tiles of row k, then all the remaining
+               tiles, each by one thread. With MPI each process updates its own rows
+               of tiles and the owner of row k broadcasts it at the start of round k.
+    -e delta   delta-stepping: the vertices are kept in buckets of width delta
+               (by distance) and all the vertices of a bucket are handled together
+               (by all the threads). Stores the graph in CSR form; one process only.
+    -e bidir   (with a destination vertex) bidirectional search: a forward search from
+               vertex 0 and a backward search from the destination (over the reversed
+               edges) take turns, each with a binary heap; it stops when the
+               two searches meet (when no shorter path can be found). Stores the
+               graph in CSR form; one process only.
+    -e alt     (with a destination vertex) A* search with landmarks (ALT): a few
+               landmark vertices are chosen (each one as far as possible from the
+               ones before it) and the distances from each landmark to every vertex and
+               from every vertex to each landmark are found (with -e heap). By the
+               triangle inequality they give a lower bound on the distance from a vertex
+               to the destination, and the search visits the vertices in order of
+               distance + bound. Stores the graph in CSR form; one process only.
+    -L k       number of landmarks for -e alt (default 8).
+    -l file    keep the landmark distances in 'file': if it has the landmarks of
+               this graph (and k) they are read from it, otherwise they are
+               found and written to it, for the next queries on the same graph.
+    -D delta   bucket width for -e delta (default: the maximum weight divided
+               by the average number of edges per vertex).
+    -2         (MPI, -e scan or fused) 2D decomposition: the processes form a grid of
+               about sqrt(P) x sqrt(P) and each one keeps one block of rows and columns
+               of 'edges'; the reductions run along the rows of the grid and the weights
+               of the current vertex are scattered along its columns (see doWork2D()).
+    -H         allocate 'edges' in huge pages (madvise(MADV_HUGEPAGE)); a binary input
+               file is then copied, not used in place. (In any case the columns of
+               'edges' are first written by the threads that use them, so that
+               they are in the memory of their socket: see first_touch(). Run
+               with OMP_PROC_BIND=true, or mpirun --bind-to, to keep the threads
+               on their cores.)
+    -c         (-e scan or fused, also -s with -e scan) once half of the vertices are done,
+               the steps visit only the vertices which are not done yet: their numbers are
+               packed into a list, which is packed again each time 1/8 of the vertices on it
+               are done (see compact_live()). Late in the run nearly all the vertices
+               are done, so for a complete graph this cuts the work of the steps
+               to about 5/8 (the vertices that are left are visited through the list,
+               one at a time, so it helps most without the SIMD kernels).
+    -s         store the graph in compressed sparse row (CSR) form: only the
+               edges that exist (weights that are not '*') are stored and 
+               updating the distances visits only the edges of the current vertex.
+               Use it for graphs with few edges.
+    -r bfs|rcm|degree
+               (CSR) renumber the vertices before solving, so that the ends of the
+               edges of nearby vertices are near each other in 'distance': in the order
+               of a breadth first search from vertex 0, reverse Cuthill-McKee, or by
+               decreasing number of edges (see reorderGraph()). The vertices of the 
+               arguments, the queries and the output are still those of the input.
+
+    -g nv[,max-weight[,seed]]
+               do not read the input: generate the same graph as
+               genGraph nv max-weight seed  would, in place. Each process generates 
+               only its own columns of 'edges' (in parallel, with OpenMP).
+
+    -m file    batch mode: find the distances from each of the source vertices listed
+               in 'file' (numbers separated by white space) instead of from vertex 0.
+               The graph is read once. The sources are divided among the threads
+               and processes (each process keeps the whole graph); each thread has its own
+               'distance'. For each source, the output is
+               "distances from vertex s:" followed by the distances (or, with a destination,
+               one line for each source).
+    -A         batch mode with all the vertices as sources (all pairs).
+    -T         write the time of each phase to the standard error, as one line:
+                   time parse=... setup=... solve=... gather=... output=...
+               (seconds; parse: reading or generating the graph, setup: distributing it 
+               and allocating, output: writing the distances. With MPI, the maximum 
+               over the processes.) bench.sh uses it.
+    -i file    read the graph from 'file' instead of the standard input. With MPI, 
+               if it is a binary graph file, every process reads only its own
+               part of it, in parallel (with MPI-IO; see readGraphParallel()),
+               instead of process 0 reading the whole graph and sending the parts.
+    -o file    write the distances to 'file' instead of the standard output (not in
+               batch mode, and without a destination vertex). With MPI every process
+               writes its own vertices into the file (with MPI-IO), so the distances
+               are not gathered by process 0.
+    -b         (with -o) write the distances as NV binary numbers of 4 bytes (in the
+               byte order of the machine; INFINITY, 1000000, if there is no path).
+    -u file    incremental updates (one process, not in batch mode): after the distances
+               are written, read batches of changes of the weights from 'file' ("-": the
+               standard input, when the graph comes from -i or -g). Each line of a batch is
+                   i j w    the edge i -> j gets weight w
+                   i j *    the edge i -> j is removed
+               and the batches are separated by empty lines. After each batch only the
+               distances that change are repaired (see doUpdates()) and the output is written
+               again, after the line "after update k:" (k = 0, 1, ...). A CSR graph
+               can only change the weights of the edges it has.
+    -S path    server mode: read the graph once, then answer queries on the Unix
+               domain socket 'path'. Each line a client sends is a query:
+                   s d      the distance from s to d ("distance from s to d is X")
+                   s *      the distances from s (as with -m)
+                   quit     close the connection
+               Each thread of the OpenMP team serves one connection at a time, with
+               its own 'distance' buffer (allocated once). One process only.
+
+  The input may also describe a sparse graph as a list of edges:
+      s nv ne
+  followed by ne triples  i j w  (an edge i -> j with weight w).
+  Such a graph is always stored in CSR form.
+  The input may also be a binary graph file (written by genGraph -b, see 
+  struct graph_header). A binary file given as the standard input (dijkstra < file)
+  is mapped into memory and, when its weights are 4 bytes, used
+  in place: nothing is read or copied before the solver touches it.
+
+  MPI version: compile with  mpicc -DUSE_MPI dijkstra.c  and run with mpirun.
+  The vertices are divided into contiguous blocks, one block per process.
+  Each process keeps only the columns of 'edges' (and the entries of
+  'distance') that belong to its own vertices.
+  In each step every process finds the closest vertex among its own
+  vertices and MPI_Allreduce (with MPI_MINLOC) selects the closest vertex
+  overall. Process 0 reads the input and writes the output.
+
+  OpenMP version: compile with  -fopenmp  (this may be combined with -DUSE_MPI).
+  The two loops of each step (finding the closest vertex and updating the
+  distances) are shared by a team of threads. The team is created once,
+  in doWork(), and is used for all the steps.
+
+  On x86-64 the loops over the vertices of a dense graph use AVX2 or AVX-512
+  instructions when the CPU has them (chosen at run time; compile with -DNO_SIMD
+  to disable them).
+
+  Compile with -DWEIGHT_BITS=8 or -DWEIGHT_BITS=16 to keep the weights of a dense
+  graph in 1 or 2 bytes instead of 4 (see WEIGHT); the input must then have only 
+  weights less than 255 or 65535.
+
+  Compile with -DPREDECESSORS to keep the predecessor of each vertex on a shortest path
+  (see pred): with a destination vertex the path is written too, as
+      path: 0 -> ... -> destination
+  (not in batch or server mode, and not with -e delta). Without it, the loops are
+  unchanged.
+
+  Compile with -DINSTRUMENT to count the work of the solver (steps, relaxations
+  attempted and successful, vertices scanned, busy time of each thread and, with
+  MPI, time spent in MPI_Allreduce); the totals are written to the standard error
+  at the end (see struct counters). Then
+    -t file    also write the busy intervals of every thread to 'file' in the Chrome
+               trace format (with MPI: file.rank, one for each process).
 */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#ifdef _OPENMP
+#include <omp.h>
+#else
+static inline int omp_get_thread_num() { return 0; }
+static inline int omp_get_max_threads() { return 1; }
+#endif
 
 typedef unsigned int VERTEX; //  vertices are numbered 0, 1, 2 ... (NV-1)
 
@@ -24,20 +213,177 @@ struct vertex {
 
 const unsigned int INFINITY = 1000000; // a large integer
 
+/* the closer of two vertices (the lower numbered one if they are at the same distance) */
+static inline struct vertex closer(struct vertex a, struct vertex b)
+{
+    if (b.distance < a.distance || (b.distance == a.distance && b.vertex < a.vertex))
+        return b;
+    return a;
+}
+
+#pragma omp declare reduction(min : struct vertex : omp_out = closer(omp_out, omp_in)) \
+        initializer(omp_priv = (struct vertex){0, INFINITY})
+
+/* Binary graph file (all numbers little endian):
+     struct graph_header
+     layout GRAPH_DENSE: NV*NV weights (row by row, like 'edges')
+     layout GRAPH_CSR:   NV+1 first_edge (8 bytes each), NE edge_to (4 bytes each),
+                         NE weights
+   Weights are 'weight_size' bytes. A weight of 4 bytes is INFINITY ('*') if it is
+   INFINITY or more; a weight of 1 or 2 bytes is INFINITY if it is 0xff or 0xffff.
+   (genGraph.c has the same definition.) */
+struct graph_header {
+    char magic[4];        // "DJKG"
+    uint8_t version;      // 1
+    uint8_t layout;       // GRAPH_DENSE or GRAPH_CSR
+    uint8_t weight_size;  // 1, 2 or 4
+    uint8_t unused1;
+    uint32_t nv;          // number of vertices
+    uint32_t unused2;
+    uint64_t ne;          // (GRAPH_CSR) number of edges
+    uint64_t unused3;
+};
+#define GRAPH_DENSE 0
+#define GRAPH_CSR   1
+
 // globals
 int NV;   // number of vertices
-int *done; /*  done[v] == 1 means we are done with vertex v. done[v] == 0 means we are not done yet. */
+int rank = 0;   // rank of this process (always 0 in the sequential version)
+int nprocs = 1; // number of processes
+
+int col_lo;     /* this process is responsible for vertices col_lo, col_lo+1 ... col_lo+col_n-1 */
+int col_n;      /* (in the sequential version col_lo == 0 and col_n == NV) */
+int row_lo;     /* this process keeps rows row_lo .. row_lo+row_n-1 of 'edges' */
+int row_n;      /* (all of them, except with -2) */
+
+/* (-2, MPI) 2D decomposition: the processes form a grid_rows x grid_cols grid and process 
+   (i, j) = (rank % grid_rows, rank / grid_rows) keeps row block i and column block j of
+   'edges'. It keeps the distances of its own block of vertices, block_start(rank) ..
+   block_start(rank+1)-1 (the blocks of the processes of column j make up column block j).
+   grid_rows == 0: the 1D decomposition (columns only). */
+int grid_2d;        // (-2)
+int grid_rows, grid_cols;
+#ifdef USE_MPI
+MPI_Comm row_comm;  // (-2) the processes of our row of the grid (rank: the column)
+MPI_Comm col_comm;  //      the processes of our column of the grid (rank: the row)
+#endif
+void doWork2D(void);
+void doWorkBulk(void);
+void doWorkGPU(void);
+
+/* The weights in 'edges' are WEIGHT_BITS bits: compile with -DWEIGHT_BITS=8 or 
+   -DWEIGHT_BITS=16 to store them in 1 or 2 bytes (then every weight must be less than
+   NO_EDGE, which stands for '*'). The distances are always 32 bits. */
+#ifndef WEIGHT_BITS
+#define WEIGHT_BITS 32
+#endif
+#if WEIGHT_BITS == 8
+typedef uint8_t WEIGHT;
+#define NO_EDGE 0xffu
+#define MPI_WEIGHT MPI_UNSIGNED_CHAR
+#elif WEIGHT_BITS == 16
+typedef uint16_t WEIGHT;
+#define NO_EDGE 0xffffu
+#define MPI_WEIGHT MPI_UNSIGNED_SHORT
+#elif WEIGHT_BITS == 32
+typedef unsigned int WEIGHT;
+#define NO_EDGE 1000000u // (INFINITY)
+#define MPI_WEIGHT MPI_UNSIGNED
+#else
+#error WEIGHT_BITS should be 8, 16 or 32
+#endif
+
+/* the weight of an entry of 'edges' (INFINITY if there is no edge) */
+static inline unsigned int weight_value(WEIGHT w)
+{
+    return w >= NO_EDGE ? INFINITY : w;
+}
+
+/* the entry of 'edges' for weight 'w' (w >= INFINITY: no edge); 
+   the caller checks weight_fits(w) */
+static inline WEIGHT dense_weight(unsigned int w)
+{
+    return w < NO_EDGE ? w : NO_EDGE;
+}
+
+static inline int weight_fits(unsigned int w)
+{
+    return w < NO_EDGE || w >= INFINITY;
+}
 
-unsigned int *edges;  /* weights of edges between vertices;
+WEIGHT *edges;  /* weights of edges between vertices;
                   'edges' is (logically) a two dimensional array:  it has NV rows (one for each vertex)
                   and NV columns (one for each vertex). The entry in row i and column j
                   is the weight of the edge i -> j. 
                   'edges' is accessed as if it was a one dimensional array: 
                   The weight of the edge i -> j is stored in 
-                  'edges[i*NV+j]'.  This is the entry in the i'th row and the j'th column. */
+                  'edges[i*NV+j]'.  This is the entry in the i'th row and the j'th column.
+                  In the MPI version each process keeps only columns col_lo .. col_lo+col_n-1:
+                  the weight of the edge i -> j is then stored in 'edges[i*col_n + (j-col_lo)]'
+                  (with -2 only rows row_lo .. row_lo+row_n-1: 'edges[(i-row_lo)*col_n + (j-col_lo)]'). */
+int huge_pages;   /* (-H) 1: allocate 'edges' in huge pages (and do not use a mapped input in place) */
+WEIGHT *alloc_edges(size_t rows, size_t cols);
+void first_touch(WEIGHT *e, size_t rows, size_t cols);
+int edges_mapped; /* 1 means 'edges' (or the CSR arrays) point into a binary input file 
+                     (they were not allocated with malloc) */
+unsigned int *converted_weight; /* (mapped CSR file of 1 or 2 byte weights) 'edge_weight', 
+                                   converted with malloc */
+unsigned char *input_copy; /* (binary file read from a pipe) the copy of the input that 'edges'
+                              (or the CSR arrays) point into, freed with them */
                                      
-int  *distance;  /* distance[v] is the minumum distance of vertex v from the source 
-                   (vertex 0) (as found so far) */
+int sparse;   /* 1 means the graph is stored in CSR form (first_edge, edge_to, edge_weight)
+                 instead of 'edges' */
+uint64_t NE;       // (CSR) number of edges stored
+uint64_t *first_edge; /* (CSR) the edges i -> ... are edges first_edge[i] .. first_edge[i+1]-1 */
+VERTEX *edge_to;      /* (CSR) edge e is the edge  ? -> edge_to[e] */
+unsigned int *edge_weight; /* (CSR) the weight of edge e */
+                      /* In the MPI version each process keeps only the edges to its own vertices */
+
+unsigned int *distance;  /* distance[v-col_lo] is the minumum distance of vertex v from the source 
+                   (vertex 0) (as found so far). After doWork() process 0 holds
+                   the distances of all the vertices (distance[v]). 
+                   While the algorithm runs, the distance of a vertex we are done with
+                   has the DONE bit too (there is no separate 'done' array). */
+#define DONE 0x80000000u
+static inline int is_done(unsigned int d) { return (d & DONE) != 0; }
+void clear_done(unsigned int *dist, int n);
+
+/* Predecessors (compile with -DPREDECESSORS): pred[v-col_lo] (indexed like 'distance') is the 
+   vertex before v on a shortest path from vertex 0 (NO_PRED for vertex 0 and the vertices
+   with no path); it is set wherever a distance is lowered. With a destination the path is
+   then written after its distance ("path: 0 -> ... -> destination"). The functions which
+   relax take the array ('pred', NULL: do not record them) and the kernels the vertex 
+   relaxed from ('from') only in that build: without it PRED_PARAM, FROM_PARAM, PRED_ARG(), 
+   FROM_ARG() and SET_PRED() are empty and the loops are the same as before.
+   (The plain C kernels record them: -DPREDECESSORS implies -DNO_SIMD. -e delta relaxes with
+   compare and swap, which has no room for them; it can not be used.) */
+#define NO_PRED 0xffffffffu
+#ifdef PREDECESSORS
+#ifndef NO_SIMD
+#define NO_SIMD
+#endif
+VERTEX *pred;
+#define PRED_PARAM , VERTEX *pred
+#define PRED_ARG(p) , (p)
+#define FROM_PARAM , VERTEX from
+#define FROM_ARG(u) , (u)
+#define SET_PRED(v, u) do { if (pred) pred[v] = (u); } while (0)
+#else
+#define PRED_PARAM
+#define PRED_ARG(p)
+#define FROM_PARAM
+#define FROM_ARG(u)
+#define SET_PRED(v, u) ((void)0)
+#endif
+void printPath(void);
+
+#define KERNEL_BLOCK 1024 /* vertices per call of the kernels (see relax_scalar()); the loops
+                            of the steps are divided among the threads by blocks */
+int compact;  /* (-c) 1: once half of the vertices are done, the steps visit only 'live' */
+VERTEX *live; /* (-c) the local vertices which were not done at the last compact_live(),
+                 in increasing order */
+int n_live = -1; /* number of vertices in 'live'; -1: not packed yet (the steps visit all col_n) */
+void compact_live(void);
 
 enum goal { FIND_ONE_DISTANCE, /* find distance from source to one 
                    vertex given as a command line argument */
@@ -48,70 +394,1117 @@ enum goal { FIND_ONE_DISTANCE, /* find distance from source to one
 VERTEX destination;  /* when goal == FIND_ONE_DISTANCE,
                         we want to find the distance from
                         the source vertex to 'destination' */
+
+enum engine { SCAN,  /* find the closest vertex and update the distances in 
+                        two separate passes */
+              FUSED, /* update the distances and find the next closest
+                        vertex in the same pass */
+              BULK,  /* each step settles all the vertices whose distance is final */
+              GPU,   /* FUSED with the steps offloaded to an accelerator (OpenMP target) */
+              FLOYD, /* (batch mode) blocked Floyd-Warshall on the dense matrix */
+              HEAP,    /* priority queue of vertices: binary heap */
+              PAIRING, /*                             pairing heap */
+              RADIX,   /*                             radix heap */
+              DELTA,   /* delta-stepping */
+              BIDIR,   /* bidirectional search (FIND_ONE_DISTANCE) */
+              ALT      /* A* with landmarks (FIND_ONE_DISTANCE) */
+} engine = SCAN;
+
+const char *engine_name[] = { "scan", "fused", "bulk", "gpu", "floyd", "heap", "pairing", "radix", "delta", "bidir", "alt" };
+#define NUM_ENGINES (sizeof(engine_name)/sizeof(engine_name[0]))
+
+unsigned int delta; // (engine == DELTA) bucket width. 0: choose automatically
+
+int batch;          // 1: batch mode (-m or -A)
+VERTEX *sources;    // (batch) the source vertices (NULL with -A: all the vertices)
+int num_sources;
+char *sources_file; // (-m)
+char *server_path;  // (-S) the socket of the server mode (NULL: not in server mode)
+
+int timing;         // (-T) 1: write the time of each phase
+enum phase { PARSE, SETUP, SOLVE, GATHER, OUTPUT, NUM_PHASES };
+const char *phase_name[NUM_PHASES] = { "parse", "setup", "solve", "gather", "output" };
+double phase_time[NUM_PHASES];
+double now(void);
+void printTiming(void);
+
+/* Instrumentation (compile with -DINSTRUMENT): each thread counts the work it does
+   in the solver loops, in its own 'struct counters' (padded so that two threads
+   never write the same cache line):
+     steps          steps of doWork() (vertices popped by the queue engines;
+                    rounds of -e delta)
+     relax_tried    relaxations attempted (vertices not done that were checked,
+                    or edges that were looked at)
+     relax_lowered  relaxations that lowered a distance
+     scanned        vertices scanned to find the closest vertex
+     busy           seconds spent in the loops over the vertices and edges
+     reduce         (MPI) seconds spent in MPI_Allreduce by global_minimum()
+   The totals are written to the standard error at the end, with the busy time of
+   the busiest thread compared to the average (the load imbalance). With -t file,
+   each busy interval is also recorded and written to 'file' as a Chrome trace
+   (chrome://tracing or ui.perfetto.dev).
+   The counters are in the plain C kernels: -DINSTRUMENT implies -DNO_SIMD. */
+#ifdef INSTRUMENT
+#ifndef NO_SIMD
+#define NO_SIMD
+#endif
+struct trace_event {
+    const char *name;
+    unsigned int step;
+    double start, end;
+};
+struct counters {
+    uint64_t steps, relax_tried, relax_lowered, scanned;
+    double busy, reduce;
+    struct trace_event *event; // (-t)
+    size_t n_events, room;
+    char pad[64];
+};
+struct counters *instr;    // instr[thread]
+unsigned int instr_step;   // the step the threads are in (for the trace)
+double instr_epoch;        // time 0 of the trace
+#define MAX_TRACE_EVENTS (1 << 20) // per thread
+double instr_clock(void);
+void instr_busy(const char *name, double start);
+void instr_trace(const char *name, double start, double end);
+#define COUNT(counter, n) (instr[omp_get_thread_num()].counter += (n))
+#define BUSY_BEGIN() double busy_begin = instr_clock()
+#define BUSY_END(name) instr_busy(name, busy_begin)
+#else
+#define COUNT(counter, n) ((void)(n))
+#define BUSY_BEGIN()
+#define BUSY_END(name)
+#endif
+char *trace_file;          // (-t)
+
+char *input_file;   // (-i) NULL: the graph is read from the standard input
+char *output_file;  // (-o) NULL: the distances are written to the standard output
+int binary_output;  // (-b) 1: write them to output_file as binary numbers
+void instr_init(void);
+void instr_report(void);
+
+int gen_nv;              // (-g) number of vertices of the generated graph (0: read the input)
+int gen_max_weight = 10; // (-g) as in genGraph
+uint64_t gen_seed = 1;
+
+enum order { NO_ORDER, BFS_ORDER, RCM_ORDER, DEGREE_ORDER };
+const char *order_name[] = { "none", "bfs", "rcm", "degree" };
+enum order order;  // (-r) the renumbering of the vertices of a CSR graph (see reorderGraph())
+VERTEX *new_id;    /* (-r) vertex v of the input is vertex new_id[v] of the graph that is solved
+                      (NULL: not renumbered). The vertices of the options, of the queries and 
+                      of the output are those of the input. */
+static inline VERTEX renumbered(VERTEX v) { return new_id ? new_id[v] : v; }
+VERTEX destination_arg; // the destination vertex as given (destination is renumbered())
+void reorderGraph(void);
+
+char *updates_file; // (-u) the changes of the weights ("-": the standard input; NULL: none)
+FILE *updates_in;   // (-u) opened before the graph is read (-i replaces the standard input)
+void doUpdates(void);
+void printResult(const char *header);
+
+int num_landmarks = 8; // (-L, engine == ALT)
+char *landmark_file;   // (-l) NULL: do not keep the landmark distances
 						
 void init(int argc, char **argv);
 void doWork();
 struct vertex find_vertex_with_minimum_distance();
 void update_distances(struct vertex current);
+void update_distances_sparse(struct vertex current);
+struct vertex update_distances_and_find_minimum(struct vertex current);
+void doWorkWithQueue();
+void queue_dijkstra(enum engine kind, VERTEX source, unsigned int *dist, long long stop PRED_PARAM);
+void doBatch();
+void doFloydWarshall();
+void printBatchResult(VERTEX s, unsigned int *result);
+void doWorkDeltaStepping();
+void doWorkBidirectional();
+void doWorkALT();
+void global_minimum(struct vertex *vmin);
+void simd_init(void);
 
 void printGraph();
 void printDistances(char *s);
+void fprintDistances(FILE *f, const char *s, const unsigned int *dist);
+void writeDistances(void);
+void doServer(void);
 void readGraph(void);
+void readBinaryGraph(void);
+int readGraphParallel(void);
+void readSources(void);
+void *xmalloc(size_t size);
+void add_edge(VERTEX j, unsigned int w);
+int block_start(int r);
+void partition(void);
+void distributeGraph(void);
+void distributeSparseGraph(void);
+void replicateGraph(void);
+void generateGraph(void);
+void gatherDistances(void);
 
 int main(int argc, char **argv)
 {  
+#ifdef USE_MPI
+    /* MPI is called only by the master thread of the OpenMP team */
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+    if (provided < MPI_THREAD_FUNNELED) {
+        if (rank == 0) fprintf(stderr, "the MPI library does not support MPI_THREAD_FUNNELED\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+#endif
     init(argc,argv);
+    if (server_path) {
+        doServer();
+        return 1; // (doServer() returns only if something went wrong)
+    }
+    double t = now();
+    if (batch) {
+        doBatch(); // (printBatchResult() adds its own time to phase_time[OUTPUT])
+        phase_time[SOLVE] = now() - t - phase_time[OUTPUT];
+        printTiming();
+        instr_report();
+#ifdef USE_MPI
+        MPI_Finalize();
+#endif
+        return 0;
+    }
+    enum goal g = goal;
+    if (updates_file)
+        goal = FIND_ALL_DISTANCES; // (the repairs start from all the distances)
     doWork();  
+    goal = g;
+    phase_time[SOLVE] = now() - t;
+    t = now();
+    if (output_file == NULL || new_id)
+        gatherDistances(); // (with -o every process writes its own distances, except with -r)
+    phase_time[GATHER] = now() - t;
 
     // printGraph(); // for debugging  
     
+    t = now();
+    if (output_file)
+        writeDistances();
+    else if (rank == 0)
+        printResult(NULL);
+    phase_time[OUTPUT] = now() - t;
+    if (updates_file)
+        doUpdates(); // (adds to phase_time[SOLVE] and phase_time[OUTPUT])
+    printTiming();
+    instr_report();
+#ifdef USE_MPI
+    MPI_Finalize();
+#endif
+}
+
+/* (process 0) write the distances (or the distance to the destination) to the standard 
+   output, after the line 'header' (unless it is NULL) */
+void printResult(const char *header)
+{
 	if (goal == FIND_ALL_DISTANCES)
-        printDistances(NULL);
-	else // goal == FIND_ONE_DISTANCE
+        fprintDistances(stdout, header, distance);
+	else { // goal == FIND_ONE_DISTANCE
+        if (header) printf("%s\n", header);
      	if (distance[destination] == INFINITY)
-            printf("no path to vertex %u\n", destination);			
-		else printf("distance from 0 to %u is %u\n", destination, 
+            printf("no path to vertex %u\n", destination_arg);			
+		else printf("distance from 0 to %u is %u\n", destination_arg, 
 	            distance[destination]);
+        printPath();
+    }
+    fflush(stdout);
+}
+
+/* (-DPREDECESSORS, process 0, after gatherDistances()) write the path from vertex 0 to 
+   the destination: "path: 0 -> ... -> destination" */
+void printPath()
+{
+#ifdef PREDECESSORS
+    if (distance[destination] >= INFINITY)
+        return;
+    int n = 0;
+    VERTEX *path = xmalloc(NV*sizeof(VERTEX));
+    for (VERTEX v = destination; v != NO_PRED && n < NV; v = pred[v])
+        path[n++] = v;
+    VERTEX *old_id = NULL; // (-r) the numbers of the input
+    if (new_id) {
+        old_id = xmalloc(NV*sizeof(VERTEX));
+        for (int v = 0; v < NV; v++)
+            old_id[new_id[v]] = v;
+    }
+    printf("path:");
+    while (n > 0) {
+        VERTEX v = path[--n];
+        printf(" %u%s", old_id ? old_id[v] : v, n > 0 ? " ->" : "\n");
+    }
+    free(old_id);
+    free(path);
+#endif
+}
+
+/* wall clock time, in seconds */
+double now()
+{
+#ifdef USE_MPI
+    return MPI_Wtime();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+/* (-T) write the times of the phases (process 0; the maximum over the processes) */
+void printTiming()
+{
+    if (!timing)
+        return;
+#ifdef USE_MPI
+    double max[NUM_PHASES];
+    MPI_Reduce(phase_time, max, NUM_PHASES, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    memcpy(phase_time, max, sizeof(max));
+#endif
+    if (rank != 0)
+        return;
+    fprintf(stderr, "time");
+    for (int p = 0; p < NUM_PHASES; p++)
+        fprintf(stderr, " %s=%.6f", phase_name[p], phase_time[p]);
+    fprintf(stderr, "\n");
+}
+
+#ifdef INSTRUMENT
+/* (the clock of the instrumentation: MPI_Wtime() may be called by the master thread only) */
+double instr_clock()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* (-t) record the interval 'name' of this thread in step instr_step
+   (joined to the last one if it is the same) */
+void instr_trace(const char *name, double start, double end)
+{
+    struct counters *c = &instr[omp_get_thread_num()];
+    if (trace_file == NULL)
+        return;
+    if (c->n_events > 0 && c->event[c->n_events-1].name == name &&
+        c->event[c->n_events-1].step == instr_step) {
+        c->event[c->n_events-1].end = end;
+        return;
+    }
+    if (c->n_events == MAX_TRACE_EVENTS)
+        return;
+    if (c->n_events == c->room) {
+        c->room = c->room ? 2*c->room : 1024;
+        c->event = realloc(c->event, c->room*sizeof(struct trace_event));
+        if (c->event == NULL) { perror("realloc"); exit(1); }
+    }
+    c->event[c->n_events++] = (struct trace_event){ name, instr_step, start, end };
+}
+
+/* this thread was busy in 'name' from 'start' until now */
+void instr_busy(const char *name, double start)
+{
+    double end = instr_clock();
+    instr[omp_get_thread_num()].busy += end - start;
+    instr_trace(name, start, end);
+}
+
+/* (-t) write the recorded intervals as a Chrome trace: process = MPI rank, thread = OpenMP thread.
+   With MPI each process writes its own file, 'trace_file'.rank */
+void writeTrace()
+{
+    char name[4096];
+    if (nprocs > 1)
+        snprintf(name, sizeof(name), "%s.%d", trace_file, rank);
+    else
+        snprintf(name, sizeof(name), "%s", trace_file);
+    FILE *f = fopen(name, "w");
+    if (f == NULL) { perror(name); return; }
+    fprintf(f, "{\"traceEvents\":[\n");
+    const char *sep = "";
+    for (int t = 0; t < omp_get_max_threads(); t++)
+        for (size_t k = 0; k < instr[t].n_events; k++) {
+            struct trace_event *e = &instr[t].event[k];
+            fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+                       "\"args\":{\"step\":%u}}", sep, e->name, rank, t,
+                       (e->start - instr_epoch)*1e6, (e->end - e->start)*1e6, e->step);
+            sep = ",\n";
+        }
+    fprintf(f, "\n]}\n");
+    if (fclose(f) != 0)
+        perror(name);
+}
+#endif
+
+/* (-DINSTRUMENT) allocate the counters of the threads */
+void instr_init()
+{
+#ifdef INSTRUMENT
+    instr = calloc(omp_get_max_threads(), sizeof(struct counters));
+    if (instr == NULL) { perror("calloc"); exit(1); }
+    instr_epoch = instr_clock();
+#else
+    if (trace_file) {
+        if (rank == 0) fprintf(stderr, "-t needs a program compiled with -DINSTRUMENT\n");
+        exit(3);
+    }
+#endif
+}
+
+/* (-DINSTRUMENT) write the totals of the counters (of all the threads and processes)
+   to the standard error, and the trace (-t) */
+void instr_report()
+{
+#ifdef INSTRUMENT
+    int threads = omp_get_max_threads();
+    uint64_t count[4] = {0, 0, 0, 0};
+    double busy_max = 0, busy_sum = 0, reduce = 0;
+    for (int t = 0; t < threads; t++) {
+        count[0] += instr[t].steps;
+        count[1] += instr[t].relax_tried;
+        count[2] += instr[t].relax_lowered;
+        count[3] += instr[t].scanned;
+        busy_sum += instr[t].busy;
+        if (instr[t].busy > busy_max)
+            busy_max = instr[t].busy;
+        reduce += instr[t].reduce;
+    }
+    if (trace_file)
+        writeTrace();
+#ifdef USE_MPI
+    uint64_t total[4];
+    double sum[2] = { busy_sum, threads }, total_sum[2], max[2] = { busy_max, reduce }, total_max[2];
+    MPI_Reduce(count, total, 4, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(sum, total_sum, 2, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(max, total_max, 2, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    memcpy(count, total, sizeof(count));
+    busy_sum = total_sum[0];
+    threads = total_sum[1];
+    busy_max = total_max[0];
+    reduce = total_max[1];
+#endif
+    if (rank != 0)
+        return;
+    if (!batch)
+        count[0] /= nprocs; // (every process counted the same steps of doWork())
+    double mean = busy_sum / threads;
+    fprintf(stderr, "count steps=%" PRIu64 " relax_tried=%" PRIu64 " relax_lowered=%" PRIu64
+                    " scanned=%" PRIu64 "\n", count[0], count[1], count[2], count[3]);
+    fprintf(stderr, "busy threads=%d max=%.6f mean=%.6f imbalance=%.3f", threads, busy_max, mean,
+                    mean > 0 ? busy_max / mean : 1.0);
+    if (nprocs > 1)
+        fprintf(stderr, " reduce=%.6f (%.1f%% of solve)", reduce,
+                        phase_time[SOLVE] > 0 ? 100 * reduce / phase_time[SOLVE] : 0.0);
+    fprintf(stderr, "\n");
+#endif
+}
+
+/* (batch mode) read the source vertices from 'sources_file' */
+void readSources()
+{
+    if (sources_file == NULL) {
+        num_sources = NV;
+        return;
+    }
+    FILE *f = fopen(sources_file, "r");
+    if (f == NULL) { perror(sources_file); exit(1); }
+    int room = 1024;
+    sources = xmalloc(room*sizeof(VERTEX));
+    unsigned int v;
+    int r;
+    while ((r = fscanf(f, "%u", &v)) == 1) {
+        if (v >= NV) {
+            if (rank == 0) fprintf(stderr, "%s: illegal source vertex %u\n", sources_file, v);
+            exit(4);
+        }
+        if (num_sources == room) {
+            room *= 2;
+            sources = realloc(sources, room*sizeof(VERTEX));
+            if (sources == NULL) { perror("realloc"); exit(1); }
+        }
+        sources[num_sources++] = v;
+    }
+    if (r != EOF) {
+        if (rank == 0) fprintf(stderr, "%s: error in the list of sources\n", sources_file);
+        exit(2);
+    }
+    fclose(f);
+}
+
+void usage(char *prog)
+{
+    if (rank == 0)
+        fprintf(stderr, "Usage: %s [-e scan|fused|bulk|gpu|floyd|heap|pairing|radix|delta|bidir|alt] [-D delta] [-L landmarks] [-l file] [-s] [-r bfs|rcm|degree] [-2] [-H] [-c] [-g nv[,max-weight[,seed]]] [-m sources-file | -A] [-i graph-file] [-o file [-b]] [-u updates-file] [-S socket] [-T] [-t trace-file] [destination vertex]\n", prog);
+    exit(3);
 }
 
 void init(int argc, char **argv)
 { 
-    readGraph(); // initialize NV and 'edges'
+    int opt;
+    simd_init();
+    while ((opt = getopt(argc, argv, "e:sD:g:m:AL:l:S:Tt:o:bi:2Hcr:u:")) != -1) {
+        switch (opt) {
+        case 'e':
+            for (engine = 0; engine < NUM_ENGINES; engine++)
+                if (strcmp(optarg, engine_name[engine]) == 0)
+                    break;
+            if (engine == NUM_ENGINES)
+                usage(argv[0]);
+            break;
+        case 'D':
+            delta = atoi(optarg);
+            if (delta == 0)
+                usage(argv[0]);
+            break;
+        case 's':
+            sparse = 1;
+            break;
+        case 'g': {
+            long long seed = gen_seed;
+            int n = sscanf(optarg, "%d,%d,%lld", &gen_nv, &gen_max_weight, &seed);
+            gen_seed = seed;
+            if (n < 1 || gen_nv <= 0 || gen_max_weight < 1 || gen_max_weight >= (int)INFINITY)
+                usage(argv[0]);
+            break;
+        }
+        case 'm':
+            batch = 1;
+            sources_file = optarg;
+            break;
+        case 'A':
+            batch = 1;
+            sources_file = NULL;
+            break;
+        case 'L':
+            num_landmarks = atoi(optarg);
+            if (num_landmarks <= 0)
+                usage(argv[0]);
+            break;
+        case 'l':
+            landmark_file = optarg;
+            break;
+        case 'T':
+            timing = 1;
+            break;
+        case 't':
+            trace_file = optarg;
+            break;
+        case 'i':
+            input_file = optarg;
+            break;
+        case '2':
+            grid_2d = 1;
+            break;
+        case 'H':
+            huge_pages = 1;
+            break;
+        case 'c':
+            compact = 1;
+            break;
+        case 'r':
+            for (order = BFS_ORDER; order <= DEGREE_ORDER; order++)
+                if (strcmp(optarg, order_name[order]) == 0)
+                    break;
+            if (order > DEGREE_ORDER)
+                usage(argv[0]);
+            break;
+        case 'o':
+            output_file = optarg;
+            break;
+        case 'u':
+            updates_file = optarg;
+            break;
+        case 'b':
+            binary_output = 1;
+            break;
+        case 'S':
+            server_path = optarg;
+            batch = 1; // (the graph is kept whole, like in batch mode)
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    instr_init();
+    if (updates_file && rank == 0) {
+        updates_in = strcmp(updates_file, "-") == 0 ? fdopen(dup(0), "r") : fopen(updates_file, "r");
+        if (updates_in == NULL) { perror(updates_file); exit(1); }
+    }
+    if (engine == FLOYD)
+        batch = 1; // (-A unless -m was given)
+    if (batch && (engine == DELTA || engine == BIDIR || engine == ALT || (engine == FLOYD && server_path))) {
+        if (rank == 0) fprintf(stderr, "-e %s can not be used in %s mode\n", engine_name[engine], 
+                               server_path ? "server" : "batch");
+        exit(3);
+    }
+
+    if (grid_2d && (batch || sparse || (engine != SCAN && engine != FUSED))) {
+        if (rank == 0) fprintf(stderr, "-2: only -e scan or fused, dense, not in batch mode\n");
+        exit(3);
+    }
+    if (compact && (batch || grid_2d || (engine != SCAN && engine != FUSED))) {
+        if (rank == 0) fprintf(stderr, "-c: only -e scan or fused, not -2, not in batch mode\n");
+        exit(3);
+    }
+    if (grid_2d && nprocs > 1) {
+        // grid_rows: the largest divisor of nprocs which is at most its square root
+        for (grid_rows = 1; (grid_rows + 1)*(grid_rows + 1) <= nprocs; grid_rows++)
+            ;
+        while (nprocs % grid_rows != 0)
+            grid_rows--;
+        grid_cols = nprocs / grid_rows;
+#ifdef USE_MPI
+        MPI_Comm_split(MPI_COMM_WORLD, rank % grid_rows, rank / grid_rows, &row_comm);
+        MPI_Comm_split(MPI_COMM_WORLD, rank / grid_rows, rank % grid_rows, &col_comm);
+#endif
+    }
 
-    if (argc > 1) {
+    if (engine >= HEAP) {
+        if (nprocs > 1 && !batch) {
+            if (rank == 0) fprintf(stderr, "-e %s runs on one process only\n", engine_name[engine]);
+            exit(3);
+        }
+        sparse = 1;
+    }
+
+    double t = now();
+    enum phase last = PARSE;
+    if (order != NO_ORDER && gen_nv > 0) {
+        if (rank == 0) fprintf(stderr, "-r: only for a graph in CSR form (not with -g)\n");
+        exit(3);
+    }
+    if (gen_nv > 0)
+        generateGraph(); // initialize NV, col_lo, col_n and the local columns of 'edges'
+    else if (order == NO_ORDER && readGraphParallel()) // (with -r process 0 reads and renumbers the graph)
+        ; // (the same, with MPI-IO)
+    else {
+        if (rank == 0) {
+            if (input_file && freopen(input_file, "r", stdin) == NULL) {
+                perror(input_file);
+                exit(1);
+            }
+            readGraph(); // initialize NV and 'edges'
+        }
+        phase_time[PARSE] = now() - t;
+        t = now();
+        if (order != NO_ORDER && rank == 0)
+            reorderGraph();
+        distributeGraph(); // initialize col_lo, col_n and the local columns of 'edges'
+#ifdef USE_MPI
+        if (order != NO_ORDER && nprocs > 1) {
+            if (rank != 0)
+                new_id = xmalloc(NV*sizeof(VERTEX));
+            MPI_Bcast(new_id, NV, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+        }
+#endif
+        last = SETUP;
+    }
+    phase_time[last] = now() - t;
+    t = now();
+
+    if (sparse && (engine == FUSED || engine == BULK || engine == GPU || engine == FLOYD || grid_rows > 0)) {
+        if (rank == 0) fprintf(stderr, "-e %s%s needs the graph in dense form (not CSR)\n", engine_name[engine],
+                               grid_rows > 0 ? " -2" : "");
+        exit(3);
+    }
+
+    if (optind < argc) {
         goal = FIND_ONE_DISTANCE;
-        destination = atoi(argv[1]);
-		if (destination >= NV) {
-			fprintf(stderr, "illegal destination vertex\n");
+        destination_arg = atoi(argv[optind]);
+		if (destination_arg >= NV) {
+			if (rank == 0) fprintf(stderr, "illegal destination vertex\n");
 			exit(4);
 		}
+        destination = renumbered(destination_arg);
     } else
         goal = FIND_ALL_DISTANCES;		
+    if ((engine == BIDIR || engine == ALT) && goal != FIND_ONE_DISTANCE) {
+        if (rank == 0) fprintf(stderr, "-e %s needs a destination vertex\n", engine_name[engine]);
+        exit(3);
+    }
+
+    if ((output_file || binary_output) && (batch || goal == FIND_ONE_DISTANCE || output_file == NULL)) {
+        if (rank == 0) fprintf(stderr, "-o: not in batch mode and no destination vertex; -b needs -o\n");
+        exit(3);
+    }
+#ifdef PREDECESSORS
+    if (engine == DELTA) {
+        if (rank == 0) fprintf(stderr, "-e delta does not record the predecessors (compiled with -DPREDECESSORS)\n");
+        exit(3);
+    }
+#endif
+    if (updates_file && (nprocs > 1 || batch || output_file || engine == BIDIR || engine == ALT)) {
+        if (rank == 0) fprintf(stderr, "-u: one process only, not in batch mode, not with -o, -e bidir or alt\n");
+        exit(3);
+    }
+    if (server_path && (nprocs > 1 || goal == FIND_ONE_DISTANCE)) {
+        if (rank == 0) fprintf(stderr, "-S: one process only and no destination vertex\n");
+        exit(3);
+    }
+    if (batch) {
+        if (!server_path)
+            readSources();
+        return; // (the scratch arrays are allocated by doBatch() or doServer())
+    }
+
+    int own_n = block_start(rank+1) - block_start(rank); // (col_n, except with -2)
+    distance = malloc(own_n*sizeof(unsigned int) + 1); // + 1: own_n may be 0
+    if (distance == NULL) { perror("malloc"); exit(1);}
+
+#pragma omp parallel for schedule(static) // (first touch, see first_touch())
+    for (int b = 0; b < own_n; b += KERNEL_BLOCK)
+        for (int v = b; v < own_n && v < b + KERNEL_BLOCK; v++)
+            distance[v] = INFINITY;
+    if (block_start(rank) == 0 && own_n > 0) // this process is responsible for vertex 0
+        distance[0] = 0;
+#ifdef PREDECESSORS
+    pred = xmalloc(own_n*sizeof(VERTEX));
+    for (int v = 0; v < own_n; v++)
+        pred[v] = NO_PRED;
+#endif
+    phase_time[SETUP] += now() - t;
+}
+
+/* first (global) vertex of the block of vertices of process 'r' */
+int block_start(int r)
+{
+    return (int)((long long)r * NV / nprocs);
+}
+
+/* the rows and columns of 'edges' that process 'r' keeps */
+void partition_of(int r, int *r_lo, int *r_n, int *c_lo, int *c_n)
+{
+    *r_lo = 0;
+    *r_n = NV;
+    if (batch) { // (in batch mode every process has all the vertices)
+        *c_lo = 0;
+        *c_n = NV;
+    } else if (grid_rows == 0) {
+        *c_lo = block_start(r);
+        *c_n = block_start(r+1) - *c_lo;
+    } else {
+        int i = r % grid_rows, j = r / grid_rows;
+        *c_lo = block_start(j*grid_rows);
+        *c_n = block_start((j+1)*grid_rows) - *c_lo;
+        *r_lo = (long long)i * NV / grid_rows;
+        *r_n = (long long)(i+1) * NV / grid_rows - *r_lo;
+    }
+}
+
+/* set row_lo, row_n, col_lo and col_n (NV is known) */
+void partition()
+{
+    partition_of(rank, &row_lo, &row_n, &col_lo, &col_n);
+}
+
+/* Give each process its block of vertices and the corresponding columns of 'edges'.
+   Process 0 (which has read the whole graph) sends each other process its columns.
+   In the sequential version this only sets col_lo and col_n.
+*/
+void distributeGraph()
+{
+#ifdef USE_MPI
+    MPI_Bcast(&NV, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&sparse, 1, MPI_INT, 0, MPI_COMM_WORLD);
+#endif
+    partition();
+#ifdef USE_MPI
+    if (nprocs == 1)
+        return;
+    if (batch) {
+        replicateGraph();
+        return;
+    }
+    if (sparse) {
+        distributeSparseGraph();
+        return;
+    }
+    if (rank == 0) {
+        for (int r = 1; r < nprocs; r++) {
+            MPI_Datatype columns; // rn_r rows of n_r consecutive weights (stride NV)
+            int rlo_r, rn_r, lo_r, n_r;
+            partition_of(r, &rlo_r, &rn_r, &lo_r, &n_r);
+            if (n_r == 0 || rn_r == 0)
+                continue;
+            MPI_Type_vector(rn_r, n_r, NV, MPI_WEIGHT, &columns);
+            MPI_Type_commit(&columns);
+            MPI_Send(edges + (size_t)rlo_r*NV + lo_r, 1, columns, r, 0, MPI_COMM_WORLD);
+            MPI_Type_free(&columns);
+        }
+        // keep only our own columns (and rows; process 0 has the first ones),
+        // copied by the threads that will use them (see first_touch())
+        WEIGHT *own = alloc_edges(row_n, col_n);
+#pragma omp parallel for schedule(static)
+        for (int b = 0; b < col_n; b += KERNEL_BLOCK)
+            for (int i = 0; i < row_n; i++)
+                for (int j = b; j < col_n && j < b + KERNEL_BLOCK; j++)
+                    own[(size_t)i*col_n + j] = edges[(size_t)i*NV + j];
+        if (!edges_mapped) 
+            free(edges);
+        free(input_copy);
+        input_copy = NULL;
+        edges = own;
+        edges_mapped = 0;
+    } else {
+        edges = alloc_edges(row_n, col_n);
+        first_touch(edges, row_n, col_n);
+        if (col_n > 0 && row_n > 0)
+            MPI_Recv(edges, row_n*col_n, MPI_WEIGHT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+#endif
+}
+
+#ifdef USE_MPI
+/* MPI_Bcast of 'count' items (count may be more than an int can hold) */
+void bcast_big(void *buf, size_t count, MPI_Datatype type, size_t item_size)
+{
+    const size_t chunk = 1 << 28;
+    for (size_t k = 0; k < count; k += chunk)
+        MPI_Bcast((char *)buf + k*item_size, count - k < chunk ? count - k : chunk, type, 0, MPI_COMM_WORLD);
+}
 
-    distance = malloc(NV*sizeof(int));
-    done = malloc(NV*sizeof(int)); 
-    if (distance == NULL || done == NULL) { perror("malloc"); exit(1);}
+/* (batch mode) distributeGraph(): every process gets the whole graph */
+void replicateGraph()
+{
+    if (sparse) {
+        MPI_Bcast(&NE, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+        if (rank != 0) {
+            first_edge = xmalloc((NV+1)*sizeof(uint64_t));
+            edge_to = xmalloc(NE*sizeof(VERTEX));
+            edge_weight = xmalloc(NE*sizeof(unsigned int));
+        }
+        bcast_big(first_edge, NV+1, MPI_UINT64_T, sizeof(uint64_t));
+        bcast_big(edge_to, NE, MPI_UNSIGNED, sizeof(VERTEX));
+        bcast_big(edge_weight, NE, MPI_UNSIGNED, sizeof(unsigned int));
+    } else {
+        if (rank != 0)
+            edges = alloc_edges(NV, NV);
+        bcast_big(edges, (size_t)NV*NV, MPI_WEIGHT, sizeof(WEIGHT));
+    }
+}
+
+/* distributeGraph() for a graph in CSR form: every process gets, for each vertex i,
+   the edges i -> j where j is one of its own vertices. */
+void distributeSparseGraph()
+{
+    if (rank == 0) {
+        uint64_t *r_first = malloc((NV+1)*sizeof(uint64_t));
+        VERTEX *r_to = malloc(NE*sizeof(VERTEX) + 1);
+        unsigned int *r_weight = malloc(NE*sizeof(unsigned int) + 1);
+        if (r_first == NULL || r_to == NULL || r_weight == NULL) { perror("malloc"); exit(1); }
+
+        for (int r = nprocs - 1; r >= 0; r--) { // process 0 last: it overwrites the full graph
+            VERTEX lo = block_start(r), hi = block_start(r+1);
+            uint64_t n = 0;
+            for (int i = 0; i < NV; i++) {
+                r_first[i] = n;
+                for (uint64_t e = first_edge[i]; e < first_edge[i+1]; e++)
+                    if (edge_to[e] >= lo && edge_to[e] < hi) {
+                        r_to[n] = edge_to[e];
+                        r_weight[n] = edge_weight[e];
+                        n++;
+                    }
+            }
+            r_first[NV] = n;
+            if (r > 0) {
+                MPI_Send(r_first, NV+1, MPI_UINT64_T, r, 0, MPI_COMM_WORLD);
+                MPI_Send(r_to, n, MPI_UNSIGNED, r, 0, MPI_COMM_WORLD);
+                MPI_Send(r_weight, n, MPI_UNSIGNED, r, 0, MPI_COMM_WORLD);
+            } else {
+                NE = n;
+                memcpy(first_edge, r_first, (NV+1)*sizeof(uint64_t));
+                memcpy(edge_to, r_to, n*sizeof(VERTEX));
+                memcpy(edge_weight, r_weight, n*sizeof(unsigned int));
+            }
+        }
+        free(r_first);
+        free(r_to);
+        free(r_weight);
+    } else {
+        first_edge = malloc((NV+1)*sizeof(uint64_t));
+        if (first_edge == NULL) { perror("malloc"); exit(1); }
+        MPI_Recv(first_edge, NV+1, MPI_UINT64_T, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        NE = first_edge[NV];
+        edge_to = malloc(NE*sizeof(VERTEX) + 1);
+        edge_weight = malloc(NE*sizeof(unsigned int) + 1);
+        if (edge_to == NULL || edge_weight == NULL) { perror("malloc"); exit(1); }
+        MPI_Recv(edge_to, NE, MPI_UNSIGNED, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        MPI_Recv(edge_weight, NE, MPI_UNSIGNED, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+}
+#endif
+
+/* (-r) Renumber the vertices of the CSR graph (process 0, before distributeGraph()).
+   The numbers of the input are arbitrary, so the distances of the ends of the edges 
+   of a vertex are anywhere in 'distance'. In a better order the ends of the edges of
+   nearby vertices are nearby too, and the relaxations touch fewer cache lines and pages:
+     bfs     the order in which a breadth first search from vertex 0 reaches them
+             (then one from each vertex it does not reach)
+     rcm     reverse Cuthill-McKee: the same, but the edges of each vertex are followed in
+             order of the degree of their ends (the fewest edges first), each search starts
+             from a vertex with the fewest edges, and the order is reversed
+     degree  the vertices with the most edges first (they are relaxed most often)
+   Only the edges out of each vertex are followed (the CSR form has no others). The source,
+   vertex 0, keeps number 0 (it changes places with the vertex which would be first).
+   new_id[] maps the vertices of the input to the new ones. */
+const uint64_t *sort_degree; // (for by_degree())
+
+int by_degree(const void *a, const void *b)
+{
+    VERTEX u = *(const VERTEX *)a, v = *(const VERTEX *)b;
+    uint64_t du = sort_degree[u+1] - sort_degree[u], dv = sort_degree[v+1] - sort_degree[v];
+    return du < dv ? -1 : du > dv ? 1 : (u > v) - (u < v);
+}
+
+void reorderGraph()
+{
+    if (!sparse) {
+        fprintf(stderr, "-r: only for a graph in CSR form (-s, or an edge list)\n");
+        exit(3);
+    }
+    VERTEX *old_id = xmalloc(NV*sizeof(VERTEX) + 1); // old_id[new_id[v]] == v
+    new_id = xmalloc(NV*sizeof(VERTEX) + 1);
+    if (order == DEGREE_ORDER) {
+        // a (stable) counting sort by decreasing number of edges
+        uint64_t max_degree = 0;
+        for (int v = 0; v < NV; v++)
+            if (first_edge[v+1] - first_edge[v] > max_degree)
+                max_degree = first_edge[v+1] - first_edge[v];
+        uint64_t *at = xmalloc((max_degree + 2)*sizeof(uint64_t));
+        memset(at, 0, (max_degree + 2)*sizeof(uint64_t));
+        for (int v = 0; v < NV; v++)
+            at[max_degree - (first_edge[v+1] - first_edge[v]) + 1]++;
+        for (uint64_t k = 0; k < max_degree; k++)
+            at[k+1] += at[k];
+        for (int v = 0; v < NV; v++)
+            old_id[at[max_degree - (first_edge[v+1] - first_edge[v])]++] = v;
+        free(at);
+    } else {
+        // breadth first searches: old_id is the queue (the vertices in the order they are reached)
+        unsigned char *seen = xmalloc(NV + 1);
+        memset(seen, 0, NV);
+        VERTEX *start = xmalloc(NV*sizeof(VERTEX) + 1); // the vertices a search may start from, in order
+        for (int v = 0; v < NV; v++)
+            start[v] = v;
+        sort_degree = first_edge;
+        if (order == RCM_ORDER)
+            qsort(start, NV, sizeof(VERTEX), by_degree);
+        int n = 0, head = 0, next_start = 0;
+        if (order == BFS_ORDER) // (the first search is from vertex 0)
+            old_id[n++] = 0, seen[0] = 1;
+        while (n < NV) {
+            if (head == n) { // a new search, from the next vertex which was not reached
+                while (seen[start[next_start]])
+                    next_start++;
+                old_id[n++] = start[next_start];
+                seen[start[next_start]] = 1;
+            }
+            VERTEX u = old_id[head++];
+            int first_new = n;
+            for (uint64_t e = first_edge[u]; e < first_edge[u+1]; e++)
+                if (!seen[edge_to[e]]) {
+                    seen[edge_to[e]] = 1;
+                    old_id[n++] = edge_to[e];
+                }
+            if (order == RCM_ORDER)
+                qsort(old_id + first_new, n - first_new, sizeof(VERTEX), by_degree);
+        }
+        if (order == RCM_ORDER)
+            for (int k = 0; k < NV/2; k++) {
+                VERTEX v = old_id[k];
+                old_id[k] = old_id[NV-1-k];
+                old_id[NV-1-k] = v;
+            }
+        free(seen);
+        free(start);
+    }
+    for (int k = 0; k < NV; k++)
+        if (old_id[k] == 0) { // the source stays vertex 0
+            old_id[k] = old_id[0];
+            old_id[0] = 0;
+            break;
+        }
+    for (int k = 0; k < NV; k++)
+        new_id[old_id[k]] = k;
+
+    // the renumbered graph: the edges of the new vertex k are those of old_id[k]
+    uint64_t *r_first = xmalloc((NV+1)*sizeof(uint64_t));
+    VERTEX *r_to = xmalloc(NE*sizeof(VERTEX) + 1);
+    unsigned int *r_weight = xmalloc(NE*sizeof(unsigned int) + 1);
+    r_first[0] = 0;
+    for (int k = 0; k < NV; k++)
+        r_first[k+1] = r_first[k] + (first_edge[old_id[k]+1] - first_edge[old_id[k]]);
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (int k = 0; k < NV; k++) {
+        uint64_t e = first_edge[old_id[k]];
+        for (uint64_t f = r_first[k]; f < r_first[k+1]; f++, e++) {
+            r_to[f] = new_id[edge_to[e]];
+            r_weight[f] = edge_weight[e];
+        }
+    }
+    if (!edges_mapped) {
+        free(first_edge);
+        free(edge_to); 
+        free(edge_weight);
+    }
+    free(converted_weight);
+    converted_weight = NULL;
+    free(input_copy);
+    input_copy = NULL;
+    edges_mapped = 0;
+    first_edge = r_first;
+    edge_to = r_to;
+    edge_weight = r_weight;
+    free(old_id);
+}
+
+/* SplitMix64: a good 64 bit hash (used as a counter based random number generator) */
+static inline uint64_t splitmix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/* the weight of the edge i -> j in the graph generated by genGraph with the given
+   seed and max_weight (genGraph.c has the same function) */
+static inline unsigned int random_weight(uint64_t seed, int max_weight, int i, int j)
+{
+    if (i == j)
+        return INFINITY;
+    uint64_t row = splitmix64(seed ^ ((uint64_t)i << 32)); // each row has its own sequence
+    unsigned int w = splitmix64(row + j) % (max_weight + 1);
+    return w == 0 ? 1 : w; // weight should be positive
+}
+
+/* -g: instead of readGraph() and distributeGraph(), every process generates its own
+   columns of the graph (or, if 'sparse', the CSR edges to its own vertices). */
+void generateGraph()
+{
+    NV = gen_nv;
+    partition();
+    if (sparse) {
+        first_edge = (uint64_t *)xmalloc((NV + 1)*sizeof(uint64_t));
+        first_edge[0] = 0;
+        for (int i = 0; i < NV; i++) {
+            for (int j = col_lo; j < col_lo + col_n; j++) {
+                unsigned int w = random_weight(gen_seed, gen_max_weight, i, j);
+                if (w < INFINITY)
+                    add_edge(j, w);
+            }
+            first_edge[i+1] = NE;
+        }
+        return;
+    }
+    if (!weight_fits(gen_max_weight)) {
+        if (rank == 0) fprintf(stderr, "-g: the maximum weight does not fit in %d bits\n", WEIGHT_BITS);
+        exit(3);
+    }
+    edges = alloc_edges(row_n, col_n);
+#pragma omp parallel for schedule(static) // (the columns of each thread, as in first_touch())
+    for (int b = 0; b < col_n; b += KERNEL_BLOCK)
+        for (int i = 0; i < row_n; i++)
+            for (int j = b; j < col_n && j < b + KERNEL_BLOCK; j++)
+                edges[(size_t)i*col_n + j] = dense_weight(random_weight(gen_seed, gen_max_weight, row_lo + i, col_lo + j));
+}
 
-    for (VERTEX v = 0; v < NV; v++)  {
-        done[v] = 0;
-        distance[v] = INFINITY;
+/* Collect the distances of all the vertices in process 0 */
+void gatherDistances()
+{
+#ifdef USE_MPI
+    if (nprocs == 1)
+        return;
+    int *counts = NULL, *starts = NULL;
+    unsigned int *all = NULL;
+    if (rank == 0) {
+        counts = malloc(nprocs*sizeof(int));
+        starts = malloc(nprocs*sizeof(int));
+        all = malloc(NV*sizeof(unsigned int));
+        if (counts == NULL || starts == NULL || all == NULL) { perror("malloc"); exit(1);}
+        for (int r = 0; r < nprocs; r++) {
+            starts[r] = block_start(r);
+            counts[r] = block_start(r+1) - starts[r];
+        }
     }
-    distance[0] = 0;
+    MPI_Gatherv(distance, block_start(rank+1) - block_start(rank), MPI_UNSIGNED, 
+                all, counts, starts, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+#ifdef PREDECESSORS
+    VERTEX *all_pred = rank == 0 ? xmalloc(NV*sizeof(VERTEX)) : NULL;
+    MPI_Gatherv(pred, block_start(rank+1) - block_start(rank), MPI_UNSIGNED, 
+                all_pred, counts, starts, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        free(pred);
+        pred = all_pred;
+    }
+#endif
+    if (rank == 0) {
+        free(distance);
+        distance = all;
+        free(counts);
+        free(starts);
+    }
+#endif
 }
 
+/* All the steps are executed by the same team of threads: every thread runs the 
+   loop below (with the same 'current' in every thread) and the loops inside
+   find_vertex_with_minimum_distance() and update_distances() are divided among
+   the threads. */
 void doWork()
 {  
+   if (engine == DELTA) {
+       doWorkDeltaStepping();
+       return;
+   }
+   if (engine == BIDIR) {
+       doWorkBidirectional();
+       return;
+   }
+   if (engine == ALT) {
+       doWorkALT();
+       return;
+   }
+   if (engine >= HEAP) {
+       doWorkWithQueue();
+       return;
+   }
+   if (grid_rows > 0) {
+       doWork2D();
+       return;
+   }
+   if (engine == BULK) {
+       doWorkBulk();
+       return;
+   }
+   if (engine == GPU) {
+       doWorkGPU();
+       return;
+   }
+   n_live = -1;
+   int settled = 0; // (-c) local vertices done since the last compact_live()
+   if (compact)
+       live = xmalloc(col_n*sizeof(VERTEX) + 1);
+
+#pragma omp parallel
+ {
    struct vertex current; // current vertex and its distance from vertex 0
+   struct vertex next = {0, INFINITY}; // (engine == FUSED) closest vertex found while updating distances
 
    for (int step = 0; step < NV; step++)  {  // step < (NV-1) should also work (see note at end of this function) 
       if (step == 0) {
          current.vertex = 0;
          current.distance = 0;
       }
+      else if (engine == FUSED)
+          current = next;
       else
           current = find_vertex_with_minimum_distance();
 
 #ifdef DEBUG
+#pragma omp master
       printf("current is %u, distance is %u\n", current.vertex,
                                 current.distance);
 #endif
@@ -130,49 +1523,2227 @@ void doWork()
 		  break;
 
       // mark current vertex as done 
-      done[current.vertex] = 1;  
-      update_distances(current);
+#pragma omp single
+    {
+      if (current.vertex >= col_lo && current.vertex < col_lo + col_n) {
+          distance[current.vertex - col_lo] |= DONE;  
+          // (-c) pack the list when half of the vertices are done, then each time 1/8 of 'live' is
+          if (compact && (n_live < 0 ? 2*++settled >= col_n : 8*++settled >= n_live)) {
+              compact_live();
+              settled = 0;
+          }
+      }
+      COUNT(steps, 1);
+#ifdef INSTRUMENT
+      instr_step = step;
+#endif
+    }
+      if (engine == FUSED)
+          next = update_distances_and_find_minimum(current);
+      else
+          update_distances(current);
    } // for
 
+#pragma omp for schedule(static)
+   for (int v = 0; v < col_n; v++)
+       distance[v] &= ~DONE;
+ } // omp parallel
+   free(live);
+   live = NULL;
+   n_live = -1;
+
    /* note: final iteration of the for loop  (step == NV-1) actually does nothing useful because all final distances
          have already been found */
 } // doWork
 
-// finds vertex closest to vertex 0 among the vertices not done.
-struct vertex
-find_vertex_with_minimum_distance()
+/* (-c) remove the vertices which are done from 'live' (the first time: put all the local
+   vertices which are not done into it), keeping them in order. Called by one thread:
+   it runs once every n_live/8 steps or less often, so it costs a few operations per step. */
+void compact_live()
+{
+   int n = 0;
+   if (n_live < 0) {
+       for (int v = 0; v < col_n; v++)
+           if (!is_done(distance[v]))
+               live[n++] = v;
+   } else {
+       for (int k = 0; k < n_live; k++)
+           if (!is_done(distance[live[k]]))
+               live[n++] = live[k];
+   }
+   COUNT(scanned, n_live < 0 ? col_n : n_live);
+   n_live = n;
+}
+
+/* '*vmin' (shared by the threads) is the closest vertex among the vertices of this process.
+   Replace it with the closest vertex among the vertices of all the processes. */
+void global_minimum(struct vertex *vmin)
+{
+#ifdef USE_MPI
+#pragma omp master
+ {
+   /* MPI_MINLOC chooses the lowest vertex number on ties, 
+      just like the local loops do. */
+   struct { int distance; int vertex; } local, global;
+   local.distance = vmin->distance;
+   local.vertex = vmin->vertex;
+#ifdef INSTRUMENT
+   double start = instr_clock();
+#endif
+   MPI_Allreduce(&local, &global, 1, MPI_2INT, MPI_MINLOC, MPI_COMM_WORLD);
+#ifdef INSTRUMENT
+   double end = instr_clock();
+   instr[omp_get_thread_num()].reduce += end - start;
+   instr_trace("allreduce", start, end);
+#endif
+   vmin->distance = global.distance;
+   vmin->vertex = global.vertex;
+ }
+#pragma omp barrier
+#endif
+}
+
+/* Kernels for the dense steps: each one handles the (local) vertices lo..hi-1 of
+   'dist' and returns a local vertex number. The vertices which are done have the
+   DONE bit in their distance: as a signed number such a distance is negative (less than
+   any alternative) and as an unsigned number it is more than INFINITY, so no test of
+   'done' is needed.
+   relax:        dist[v] = min(dist[v], d0 + row[v]) for the vertices not done
+   argmin:       the closest vertex which is not done ({0, INFINITY} if none)
+   relax_argmin: both in one pass (the minimum is taken after the update)
+   There is a plain C version of each and, on x86-64, AVX2 and AVX-512 versions 
+   which handle 8 or 16 vertices at a time.
+   simd_init() selects the best version the CPU supports (compile with -DNO_SIMD
+   to use the plain C versions only). */
+
+static void relax_scalar(unsigned int *dist, const WEIGHT *row, unsigned int d0, int lo, int hi PRED_PARAM FROM_PARAM)
+{
+    uint64_t tried = 0, lowered = 0; // (-DINSTRUMENT)
+    for (int v = lo; v < hi; v++) {
+        unsigned int alternative = d0 + weight_value(row[v]);
+        tried += !is_done(dist[v]);
+        if ((int)alternative < (int)dist[v]) { // (false if v is done)
+            dist[v] = alternative; 
+            SET_PRED(v, from);
+            lowered++;
+        }
+    }
+    COUNT(relax_tried, tried);
+    COUNT(relax_lowered, lowered);
+}
+
+static struct vertex argmin_scalar(const unsigned int *dist, int lo, int hi)
+{
+    struct vertex vmin = { 0, INFINITY };
+    for (int v = lo; v < hi; v++) {
+#ifdef DEBUG
+        printf("finding min: v=%d, done=%d distance[v]= %u  vmin.distance=%u\n",
+                      v, is_done(dist[v]), dist[v] & ~DONE, vmin.distance); 
+#endif
+        if (dist[v] < vmin.distance)  { // (false if v is done)
+            vmin.distance = dist[v];
+            vmin.vertex = v;
+        }
+    }
+    COUNT(scanned, hi - lo);
+    return vmin;
+}
+
+static struct vertex relax_argmin_scalar(unsigned int *dist, const WEIGHT *row, unsigned int d0, int lo, int hi PRED_PARAM FROM_PARAM)
+{
+    struct vertex vmin = { 0, INFINITY };
+    uint64_t tried = 0, lowered = 0; // (-DINSTRUMENT)
+    for (int v = lo; v < hi; v++) {
+        unsigned int d = dist[v];
+        unsigned int alternative = d0 + weight_value(row[v]);
+        tried += !is_done(d);
+        if ((int)alternative < (int)d) {
+            dist[v] = d = alternative; 
+            SET_PRED(v, from);
+            lowered++;
+        }
+        if (d < vmin.distance) {
+            vmin.distance = d;
+            vmin.vertex = v;
+        }
+    }
+    COUNT(relax_tried, tried);
+    COUNT(relax_lowered, lowered);
+    COUNT(scanned, hi - lo);
+    return vmin;
+}
+
+/* The same three kernels for the vertices list[lo], ..., list[hi-1] (-c: list is 'live').
+   The list is in increasing order, so ties go to the lower numbered vertex, as above. */
+static void relax_list(unsigned int *dist, const WEIGHT *row, unsigned int d0, const VERTEX *list,
+                       int lo, int hi PRED_PARAM FROM_PARAM)
+{
+    uint64_t tried = 0, lowered = 0; // (-DINSTRUMENT)
+    for (int k = lo; k < hi; k++) {
+        VERTEX v = list[k];
+        unsigned int alternative = d0 + weight_value(row[v]);
+        tried += !is_done(dist[v]);
+        if ((int)alternative < (int)dist[v]) {
+            dist[v] = alternative; 
+            SET_PRED(v, from);
+            lowered++;
+        }
+    }
+    COUNT(relax_tried, tried);
+    COUNT(relax_lowered, lowered);
+}
+
+static struct vertex argmin_list(const unsigned int *dist, const VERTEX *list, int lo, int hi)
+{
+    struct vertex vmin = { 0, INFINITY };
+    for (int k = lo; k < hi; k++)
+        if (dist[list[k]] < vmin.distance) {
+            vmin.distance = dist[list[k]];
+            vmin.vertex = list[k];
+        }
+    COUNT(scanned, hi - lo);
+    return vmin;
+}
+
+static struct vertex relax_argmin_list(unsigned int *dist, const WEIGHT *row, unsigned int d0, const VERTEX *list,
+                                       int lo, int hi PRED_PARAM FROM_PARAM)
+{
+    struct vertex vmin = { 0, INFINITY };
+    uint64_t tried = 0, lowered = 0; // (-DINSTRUMENT)
+    for (int k = lo; k < hi; k++) {
+        VERTEX v = list[k];
+        unsigned int d = dist[v];
+        unsigned int alternative = d0 + weight_value(row[v]);
+        tried += !is_done(d);
+        if ((int)alternative < (int)d) {
+            dist[v] = d = alternative; 
+            SET_PRED(v, from);
+            lowered++;
+        }
+        if (d < vmin.distance) {
+            vmin.distance = d;
+            vmin.vertex = v;
+        }
+    }
+    COUNT(relax_tried, tried);
+    COUNT(relax_lowered, lowered);
+    COUNT(scanned, hi - lo);
+    return vmin;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(NO_SIMD)
+#include <immintrin.h>
+
+/* (AVX2) a < b for unsigned lanes */
+__attribute__((target("avx2")))
+static inline __m256i lt_epu32(__m256i a, __m256i b)
+{
+    return _mm256_andnot_si256(_mm256_cmpeq_epi32(_mm256_max_epu32(a, b), a), _mm256_set1_epi32(-1));
+}
+
+/* (AVX2) weight_value() of the 8 weights at 'p' */
+__attribute__((target("avx2")))
+static inline __m256i load_weights_avx2(const WEIGHT *p)
+{
+#if WEIGHT_BITS == 8
+    __m256i w = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p));
+#elif WEIGHT_BITS == 16
+    __m256i w = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)p));
+#else
+    __m256i w = _mm256_loadu_si256((const __m256i *)p);
+#endif
+    __m256i no_edge = _mm256_cmpeq_epi32(_mm256_max_epu32(w, _mm256_set1_epi32(NO_EDGE)), w); // w >= NO_EDGE
+    return _mm256_blendv_epi8(w, _mm256_set1_epi32(INFINITY), no_edge);
+}
+
+/* (AVX2) the closest of the 8 lanes (best[k] is at vertex at[k]) */
+__attribute__((target("avx2")))
+static struct vertex closest_lane_avx2(__m256i best, __m256i at)
+{
+    unsigned int d[8], v[8];
+    _mm256_storeu_si256((__m256i *)d, best);
+    _mm256_storeu_si256((__m256i *)v, at);
+    struct vertex vmin = { 0, INFINITY };
+    for (int k = 0; k < 8; k++)
+        if (d[k] < INFINITY)
+            vmin = closer(vmin, (struct vertex){ v[k], d[k] });
+    return vmin;
+}
+
+__attribute__((target("avx2")))
+static void relax_avx2(unsigned int *dist, const WEIGHT *row, unsigned int d0, int lo, int hi)
+{
+    __m256i vd0 = _mm256_set1_epi32(d0);
+    int v = lo;
+    for (; v + 8 <= hi; v += 8) {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dist + v));
+        __m256i alternative = _mm256_add_epi32(vd0, load_weights_avx2(row + v));
+        _mm256_storeu_si256((__m256i *)(dist + v), _mm256_min_epi32(d, alternative)); // (signed)
+    }
+    relax_scalar(dist, row, d0, v, hi);
+}
+
+__attribute__((target("avx2")))
+static struct vertex argmin_avx2(const unsigned int *dist, int lo, int hi)
+{
+    __m256i best = _mm256_set1_epi32(INFINITY), at = _mm256_setzero_si256();
+    __m256i index = _mm256_add_epi32(_mm256_set1_epi32(lo), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    __m256i eight = _mm256_set1_epi32(8);
+    int v = lo;
+    for (; v + 8 <= hi; v += 8, index = _mm256_add_epi32(index, eight)) {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dist + v));
+        __m256i less = lt_epu32(d, best);
+        best = _mm256_blendv_epi8(best, d, less);
+        at = _mm256_blendv_epi8(at, index, less);
+    }
+    return closer(closest_lane_avx2(best, at), argmin_scalar(dist, v, hi));
+}
+
+__attribute__((target("avx2")))
+static struct vertex relax_argmin_avx2(unsigned int *dist, const WEIGHT *row, unsigned int d0, int lo, int hi)
+{
+    __m256i vd0 = _mm256_set1_epi32(d0);
+    __m256i best = _mm256_set1_epi32(INFINITY), at = _mm256_setzero_si256();
+    __m256i index = _mm256_add_epi32(_mm256_set1_epi32(lo), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    __m256i eight = _mm256_set1_epi32(8);
+    int v = lo;
+    for (; v + 8 <= hi; v += 8, index = _mm256_add_epi32(index, eight)) {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dist + v));
+        __m256i alternative = _mm256_add_epi32(vd0, load_weights_avx2(row + v));
+        d = _mm256_min_epi32(d, alternative);
+        _mm256_storeu_si256((__m256i *)(dist + v), d);
+        __m256i less = lt_epu32(d, best);
+        best = _mm256_blendv_epi8(best, d, less);
+        at = _mm256_blendv_epi8(at, index, less);
+    }
+    return closer(closest_lane_avx2(best, at), relax_argmin_scalar(dist, row, d0, v, hi));
+}
+
+/* (AVX-512) weight_value() of the 16 weights at 'p' */
+__attribute__((target("avx512f")))
+static inline __m512i load_weights_avx512(const WEIGHT *p)
+{
+#if WEIGHT_BITS == 8
+    __m512i w = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)p));
+#elif WEIGHT_BITS == 16
+    __m512i w = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i *)p));
+#else
+    __m512i w = _mm512_loadu_si512(p);
+#endif
+    __mmask16 no_edge = _mm512_cmpge_epu32_mask(w, _mm512_set1_epi32(NO_EDGE));
+    return _mm512_mask_mov_epi32(w, no_edge, _mm512_set1_epi32(INFINITY));
+}
+
+/* (AVX-512) the closest of the 16 lanes: the lowest vertex among the lanes with the minimum */
+__attribute__((target("avx512f")))
+static struct vertex closest_lane_avx512(__m512i best, __m512i at)
+{
+    unsigned int d = _mm512_reduce_min_epu32(best);
+    if (d >= INFINITY)
+        return (struct vertex){ 0, INFINITY };
+    __mmask16 m = _mm512_cmpeq_epi32_mask(best, _mm512_set1_epi32(d));
+    return (struct vertex){ (VERTEX)_mm512_mask_reduce_min_epu32(m, at), d };
+}
+
+__attribute__((target("avx512f")))
+static void relax_avx512(unsigned int *dist, const WEIGHT *row, unsigned int d0, int lo, int hi)
+{
+    __m512i vd0 = _mm512_set1_epi32(d0);
+    int v = lo;
+    for (; v + 16 <= hi; v += 16) {
+        __m512i d = _mm512_loadu_si512(dist + v);
+        __m512i alternative = _mm512_add_epi32(vd0, load_weights_avx512(row + v));
+        _mm512_mask_storeu_epi32(dist + v, _mm512_cmplt_epi32_mask(alternative, d), alternative); // (signed)
+    }
+    relax_scalar(dist, row, d0, v, hi);
+}
+
+__attribute__((target("avx512f")))
+static struct vertex argmin_avx512(const unsigned int *dist, int lo, int hi)
+{
+    __m512i best = _mm512_set1_epi32(INFINITY), at = _mm512_setzero_si512();
+    __m512i index = _mm512_add_epi32(_mm512_set1_epi32(lo), _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    __m512i sixteen = _mm512_set1_epi32(16);
+    int v = lo;
+    for (; v + 16 <= hi; v += 16, index = _mm512_add_epi32(index, sixteen)) {
+        __m512i d = _mm512_loadu_si512(dist + v);
+        __mmask16 less = _mm512_cmplt_epu32_mask(d, best);
+        best = _mm512_mask_mov_epi32(best, less, d);
+        at = _mm512_mask_mov_epi32(at, less, index);
+    }
+    return closer(closest_lane_avx512(best, at), argmin_scalar(dist, v, hi));
+}
+
+__attribute__((target("avx512f")))
+static struct vertex relax_argmin_avx512(unsigned int *dist, const WEIGHT *row, unsigned int d0, int lo, int hi)
+{
+    __m512i vd0 = _mm512_set1_epi32(d0);
+    __m512i best = _mm512_set1_epi32(INFINITY), at = _mm512_setzero_si512();
+    __m512i index = _mm512_add_epi32(_mm512_set1_epi32(lo), _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    __m512i sixteen = _mm512_set1_epi32(16);
+    int v = lo;
+    for (; v + 16 <= hi; v += 16, index = _mm512_add_epi32(index, sixteen)) {
+        __m512i d = _mm512_loadu_si512(dist + v);
+        __m512i alternative = _mm512_add_epi32(vd0, load_weights_avx512(row + v));
+        __mmask16 lower = _mm512_cmplt_epi32_mask(alternative, d);
+        _mm512_mask_storeu_epi32(dist + v, lower, alternative);
+        d = _mm512_mask_mov_epi32(d, lower, alternative);
+        __mmask16 less = _mm512_cmplt_epu32_mask(d, best);
+        best = _mm512_mask_mov_epi32(best, less, d);
+        at = _mm512_mask_mov_epi32(at, less, index);
+    }
+    return closer(closest_lane_avx512(best, at), relax_argmin_scalar(dist, row, d0, v, hi));
+}
+#endif
+
+void (*relax_kernel)(unsigned int *dist, const WEIGHT *row, unsigned int d0, int lo, int hi PRED_PARAM FROM_PARAM) = relax_scalar;
+struct vertex (*argmin_kernel)(const unsigned int *dist, int lo, int hi) = argmin_scalar;
+struct vertex (*relax_argmin_kernel)(unsigned int *dist, const WEIGHT *row, unsigned int d0, int lo, int hi PRED_PARAM FROM_PARAM) = relax_argmin_scalar;
+
+/* choose the kernels for this CPU */
+void simd_init()
+{
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(NO_SIMD)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        relax_kernel = relax_avx512;
+        argmin_kernel = argmin_avx512;
+        relax_argmin_kernel = relax_argmin_avx512;
+    } else if (__builtin_cpu_supports("avx2")) {
+        relax_kernel = relax_avx2;
+        argmin_kernel = argmin_avx2;
+        relax_argmin_kernel = relax_argmin_avx2;
+    }
+#endif
+}
+
+/* Placement of 'edges' in memory (NUMA). A page of memory is placed on the socket
+   of the thread which first writes it. In every step the loops over the vertices 
+   give each thread the same columns (the blocks of KERNEL_BLOCK vertices of 
+   'for (b = 0; b < col_n; b += KERNEL_BLOCK)' with schedule(static)), so the 
+   columns of each thread are written first by that thread, with the same loop:
+   first_touch() before the matrix is filled from a single thread (or received),
+   or the same loop when it is filled in parallel. (This needs the threads to stay
+   on their cores: run with OMP_PROC_BIND=true, or for example OMP_PLACES=cores 
+   OMP_PROC_BIND=spread.)
+   With -H the matrix is also allocated in (transparent) huge pages, which cuts
+   the TLB misses of the scans of the rows. */
+#define HUGE_PAGE (2u << 20)
+
+/* allocate rows x cols weights for 'edges' */
+WEIGHT *alloc_edges(size_t rows, size_t cols)
+{
+    size_t size = rows*cols*sizeof(WEIGHT) + 1;
+    if (!huge_pages)
+        return xmalloc(size);
+    void *p;
+    size = (size + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+    if (posix_memalign(&p, HUGE_PAGE, size) != 0) {
+        fprintf(stderr, "can not allocate %zu bytes\n", size);
+        exit(1);
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(p, size, MADV_HUGEPAGE);
+#endif
+    return p;
+}
+
+/* write every entry of 'e' (rows x cols) with NO_EDGE, each column by the thread that 
+   will use it */
+void first_touch(WEIGHT *e, size_t rows, size_t cols)
+{
+#pragma omp parallel for schedule(static)
+    for (long b = 0; b < (long)cols; b += KERNEL_BLOCK)
+        for (size_t i = 0; i < rows; i++)
+            for (size_t j = b; j < cols && j < b + KERNEL_BLOCK; j++)
+                e[i*cols + j] = NO_EDGE;
+}
+
+// finds vertex closest to vertex 0 among the vertices not done.
+// (called by all the threads of the team; all of them get the same result)
+struct vertex
+find_vertex_with_minimum_distance()
 {  
-   struct vertex vmin;
+   static struct vertex vmin; // static: shared by the threads
+
+#pragma omp single
+ {
+   vmin.distance = INFINITY; 
+   vmin.vertex = 0;
+ }
+
+   const int n = n_live >= 0 ? n_live : col_n; // (-c) the vertices of 'live', or all of them
+#pragma omp for schedule(static) reduction(min: vmin)
+   for (int b = 0; b < n; b += KERNEL_BLOCK) {
+      BUSY_BEGIN();
+      int end = b + KERNEL_BLOCK < n ? b + KERNEL_BLOCK : n;
+      struct vertex m = n_live >= 0 ? argmin_list(distance, live, b, end) : argmin_kernel(distance, b, end);
+      BUSY_END("argmin");
+      if (m.distance < INFINITY) {
+         m.vertex += col_lo;
+         vmin = closer(vmin, m);
+      }
+   }
+   global_minimum(&vmin);
+   return vmin; // note: when vmin.distance is INFINITY, vmin.vertex is meaningless
+}
+
+
+/* Update distances for  vertices.
+   For each vertex v (which is not 'done' yet), ask whether a shorter path to v 
+   exists, through vertex 'current'. 
+   (only the vertices of this process are updated).
+*/ 
+void update_distances(struct vertex current)
+{
+   if (sparse) {
+#pragma omp single
+       update_distances_sparse(current);
+       return;
+   }
+
+   WEIGHT *row = edges + (size_t)current.vertex*col_n; // weights of edges current -> (our vertices)
+   const int n = n_live >= 0 ? n_live : col_n;
+
+#pragma omp for schedule(static)
+   for (int b = 0; b < n; b += KERNEL_BLOCK) {
+       BUSY_BEGIN();
+       int end = b + KERNEL_BLOCK < n ? b + KERNEL_BLOCK : n;
+       if (n_live >= 0)
+           relax_list(distance, row, current.distance, live, b, end PRED_ARG(pred) FROM_ARG(current.vertex));
+       else
+           relax_kernel(distance, row, current.distance, b, end PRED_ARG(pred) FROM_ARG(current.vertex));
+       BUSY_END("relax");
+   }
+   // print_distances("distances:");
+}
+
+/* update_distances() for a graph in CSR form: only the edges current -> v are visited */
+void update_distances_sparse(struct vertex current)
+{
+   BUSY_BEGIN();
+   COUNT(relax_tried, first_edge[current.vertex+1] - first_edge[current.vertex]);
+   for (uint64_t e = first_edge[current.vertex]; e < first_edge[current.vertex+1]; e++) {
+       int v = edge_to[e] - col_lo;
+       unsigned int alternative = current.distance + edge_weight[e];
+       if ((int)alternative < (int)distance[v]) { // (false if v is done)
+           distance[v] = alternative; 
+           SET_PRED(v, current.vertex);
+           COUNT(relax_lowered, 1);
+       }
+   }
+   BUSY_END("relax");
+}
+
+/* Same as update_distances() followed by find_vertex_with_minimum_distance(),
+   but in one pass over 'distance' instead of two. 
+   Returns the closest vertex (among the vertices not done) after the update.
+*/
+struct vertex update_distances_and_find_minimum(struct vertex current)
+{
+   static struct vertex vmin; // static: shared by the threads
+   WEIGHT *row = edges + (size_t)current.vertex*col_n;
+
+#pragma omp single
+ {
    vmin.distance = INFINITY; 
+   vmin.vertex = 0;
+ }
+
+   const int n = n_live >= 0 ? n_live : col_n;
+#pragma omp for schedule(static) reduction(min: vmin)
+   for (int b = 0; b < n; b += KERNEL_BLOCK) {
+       BUSY_BEGIN();
+       int end = b + KERNEL_BLOCK < n ? b + KERNEL_BLOCK : n;
+       struct vertex m = n_live >= 0 
+           ? relax_argmin_list(distance, row, current.distance, live, b, end PRED_ARG(pred) FROM_ARG(current.vertex))
+           : relax_argmin_kernel(distance, row, current.distance, b, end PRED_ARG(pred) FROM_ARG(current.vertex));
+       BUSY_END("relax_argmin");
+       if (m.distance < INFINITY) {
+           m.vertex += col_lo;
+           vmin = closer(vmin, m);
+       }
+   }
+   global_minimum(&vmin);
+   return vmin;
+}
+
+#ifdef USE_MPI
+/* global_minimum() for -2, in two steps: along the row of the grid, then along its column */
+void grid_minimum(struct vertex *vmin)
+{
+#pragma omp master
+ {
+   struct { int distance; int vertex; } local, row, global;
+   local.distance = vmin->distance;
+   local.vertex = vmin->vertex;
+#ifdef INSTRUMENT
+   double start = instr_clock();
+#endif
+   MPI_Allreduce(&local, &row, 1, MPI_2INT, MPI_MINLOC, row_comm);
+   MPI_Allreduce(&row, &global, 1, MPI_2INT, MPI_MINLOC, col_comm);
+#ifdef INSTRUMENT
+   double end = instr_clock();
+   instr[omp_get_thread_num()].reduce += end - start;
+   instr_trace("allreduce", start, end);
+#endif
+   vmin->distance = global.distance;
+   vmin->vertex = global.vertex;
+ }
+#pragma omp barrier
+}
+#endif
+
+/* doWork() with the 2D decomposition (-2; see grid_rows). In each step:
+   - each process finds the closest vertex among its own block of vertices (NV/P of them)
+     and two MPI_Allreduce (MINLOC) find the closest one overall: first in the rows of
+     the grid, then in the columns (grid_minimum());
+   - in the column j of the grid, the process that has the row of the current vertex u 
+     (the process of row block 'root') scatters the weights u -> (column block j) 
+     with MPI_Scatterv: each process of the column gets the weights to
+     its own vertices and updates their distances.
+   So every message goes to the processes of one row or one column of the grid
+   (sqrt(P) of them, for a square grid) instead of to all P processes, and each process
+   updates NV/P distances. The loops over each process's vertices are divided among 
+   the threads, as in doWork(). */
+void doWork2D()
+{
+#ifdef USE_MPI
+   const VERTEX own_lo = block_start(rank);
+   const int own_n = block_start(rank+1) - own_lo;
+   const int i = rank % grid_rows, j = rank / grid_rows; // our place in the grid
+   int *counts = xmalloc(grid_rows*sizeof(int)), *starts = xmalloc(grid_rows*sizeof(int));
+   for (int k = 0; k < grid_rows; k++) { // the blocks of the processes of column j, in the column block
+       starts[k] = block_start(j*grid_rows + k) - col_lo;
+       counts[k] = block_start(j*grid_rows + k + 1) - block_start(j*grid_rows + k);
+   }
+   WEIGHT *row = xmalloc(own_n*sizeof(WEIGHT) + 1); // weights u -> (our own vertices)
+   struct vertex vmin = {0, 0}; // (shared) the closest vertex overall; vertex 0 in step 0
+
+#pragma omp parallel
+ {
+   for (int step = 0; step < NV; step++) {
+      if (step > 0 && engine == SCAN) {
+#pragma omp single
+         vmin = (struct vertex){0, INFINITY};
+#pragma omp for schedule(static) reduction(min: vmin)
+         for (int b = 0; b < own_n; b += KERNEL_BLOCK) {
+            BUSY_BEGIN();
+            struct vertex m = argmin_kernel(distance, b, b + KERNEL_BLOCK < own_n ? b + KERNEL_BLOCK : own_n);
+            BUSY_END("argmin");
+            if (m.distance < INFINITY) {
+               m.vertex += own_lo;
+               vmin = closer(vmin, m);
+            }
+         }
+         grid_minimum(&vmin);
+      }
+      struct vertex current = vmin; // (engine == FUSED: found while updating the distances)
+      if (current.distance >= INFINITY)
+          break;
+      if (goal == FIND_ONE_DISTANCE && current.vertex == destination)
+          break;
+
+#pragma omp master
+    {
+      VERTEX u = current.vertex;
+      if (u >= own_lo && u < own_lo + own_n)
+          distance[u - own_lo] |= DONE;
+      int root = (long long)u * grid_rows / NV; // the row block of u
+      while (root + 1 < grid_rows && (long long)(root + 1) * NV / grid_rows <= u)
+          root++;
+      while ((long long)root * NV / grid_rows > u)
+          root--;
+      MPI_Scatterv(i == root ? edges + (size_t)(u - row_lo)*col_n : NULL, counts, starts, MPI_WEIGHT,
+                   row, own_n, MPI_WEIGHT, root, col_comm);
+      COUNT(steps, 1);
+#ifdef INSTRUMENT
+      instr_step = step;
+#endif
+    }
+#pragma omp barrier
+
+      if (engine == FUSED) {
+#pragma omp single
+         vmin = (struct vertex){0, INFINITY};
+#pragma omp for schedule(static) reduction(min: vmin)
+         for (int b = 0; b < own_n; b += KERNEL_BLOCK) {
+            BUSY_BEGIN();
+            struct vertex m = relax_argmin_kernel(distance, row, current.distance, b, 
+                                                  b + KERNEL_BLOCK < own_n ? b + KERNEL_BLOCK : own_n
+                                                  PRED_ARG(pred) FROM_ARG(current.vertex));
+            BUSY_END("relax_argmin");
+            if (m.distance < INFINITY) {
+               m.vertex += own_lo;
+               vmin = closer(vmin, m);
+            }
+         }
+         grid_minimum(&vmin);
+      } else {
+#pragma omp for schedule(static)
+         for (int b = 0; b < own_n; b += KERNEL_BLOCK) {
+            BUSY_BEGIN();
+            relax_kernel(distance, row, current.distance, b, b + KERNEL_BLOCK < own_n ? b + KERNEL_BLOCK : own_n
+                         PRED_ARG(pred) FROM_ARG(current.vertex));
+            BUSY_END("relax");
+         }
+      }
+   }
+
+#pragma omp for schedule(static)
+   for (int v = 0; v < own_n; v++)
+       distance[v] &= ~DONE;
+ } // omp parallel
+   free(row); free(counts); free(starts);
+#endif
+}
+
+/* doWork() for engine == BULK.
+   Let d be the smallest distance of the vertices which are not done and w the smallest
+   weight of an edge. Every vertex whose distance is less than d + w (at least d itself) 
+   has its final distance: a shorter path would have to leave the done vertices through
+   a vertex at distance >= d and then take an edge of weight >= w. So a step marks all 
+   of them as done ('settled') and then updates the distances from each of them.
+   With MPI each process finds the settled vertices among its own vertices; they are
+   sent to all the processes (MPI_Iallgatherv) while the threads update the distances
+   from our own settled vertices, and the distances from the others' are updated when 
+   they arrive. The master thread calls MPI_Test() between its blocks so that the
+   communication makes progress while it computes. */
+void doWorkBulk()
+{
+   unsigned int min_w = INFINITY;
+#pragma omp parallel for schedule(static) reduction(min: min_w)
+   for (int i = 0; i < NV; i++)
+       for (int j = 0; j < col_n; j++)
+           if (weight_value(edges[(size_t)i*col_n + j]) < min_w)
+               min_w = weight_value(edges[(size_t)i*col_n + j]);
+#ifdef USE_MPI
+   MPI_Allreduce(MPI_IN_PLACE, &min_w, 1, MPI_UNSIGNED, MPI_MIN, MPI_COMM_WORLD);
+   int *counts = xmalloc(nprocs*sizeof(int)), *starts = xmalloc(nprocs*sizeof(int));
+   MPI_Request request = MPI_REQUEST_NULL;
+#endif
+   if (min_w == 0)
+       min_w = 1; // (then only the vertices at distance d are settled)
+
+   /* the settled vertices of this step (vertex, distance): ours, then everyone's 
+      (process r's at settled[2*starts[r]] ...) */
+   unsigned int *mine = xmalloc(2*(size_t)col_n*sizeof(unsigned int) + 1);
+   unsigned int *settled = nprocs > 1 ? xmalloc(2*(size_t)NV*sizeof(unsigned int)) : mine;
+   int n_mine = 0, n_settled = 0;
+   unsigned int d = 0;   // (shared) the smallest distance (vertex 0 in step 0)
+   int finished = 0;
+
+#pragma omp parallel
+ {
+   for (int step = 0; ; step++) {
+      if (step > 0) {
+#pragma omp single
+         d = INFINITY;
+#pragma omp for schedule(static) reduction(min: d)
+         for (int b = 0; b < col_n; b += KERNEL_BLOCK) {
+            struct vertex m = argmin_kernel(distance, b, b + KERNEL_BLOCK < col_n ? b + KERNEL_BLOCK : col_n);
+            if (m.distance < d)
+               d = m.distance;
+         }
+#ifdef USE_MPI
+#pragma omp master
+       {
+#ifdef INSTRUMENT
+         double start = instr_clock();
+#endif
+         MPI_Allreduce(MPI_IN_PLACE, &d, 1, MPI_UNSIGNED, MPI_MIN, MPI_COMM_WORLD);
+#ifdef INSTRUMENT
+         double end = instr_clock();
+         instr[0].reduce += end - start;
+         instr_trace("allreduce", start, end);
+#endif
+       }
+#pragma omp barrier
+#endif
+      }
+      if (d >= INFINITY || finished)
+          break;
+
+      // settle our vertices at distance < d + min_w
+      const unsigned int limit = d + min_w;
+#pragma omp single
+      n_mine = 0;
+#pragma omp for schedule(static)
+      for (int v = 0; v < col_n; v++)
+          if (distance[v] < limit) { // (false if v is done)
+              int k;
+#pragma omp atomic capture
+              k = n_mine++;
+              mine[2*k] = col_lo + v;
+              mine[2*k+1] = distance[v];
+              distance[v] |= DONE;
+          }
+#pragma omp master
+    {
+      COUNT(steps, 1);
+#ifdef INSTRUMENT
+      instr_step = step;
+#endif
+#ifdef USE_MPI
+      if (nprocs > 1) {
+          MPI_Allgather(&n_mine, 1, MPI_INT, counts, 1, MPI_INT, MPI_COMM_WORLD);
+          n_settled = 0;
+          for (int r = 0; r < nprocs; r++) {
+              starts[r] = 2*n_settled;
+              n_settled += counts[r];
+              counts[r] *= 2;
+          }
+          MPI_Iallgatherv(mine, 2*n_mine, MPI_UNSIGNED, settled, counts, starts, MPI_UNSIGNED,
+                          MPI_COMM_WORLD, &request);
+      } else
+#endif
+          n_settled = n_mine;
+    }
+#pragma omp barrier
+
+      // update the distances from our own settled vertices (while the others' arrive)
+#pragma omp for schedule(static)
+      for (int b = 0; b < col_n; b += KERNEL_BLOCK) {
+          BUSY_BEGIN();
+          for (int k = 0; k < n_mine; k++)
+              relax_kernel(distance, edges + (size_t)mine[2*k]*col_n, mine[2*k+1], b, 
+                           b + KERNEL_BLOCK < col_n ? b + KERNEL_BLOCK : col_n PRED_ARG(pred) FROM_ARG(mine[2*k]));
+          BUSY_END("relax");
+#ifdef USE_MPI
+          if (omp_get_thread_num() == 0 && request != MPI_REQUEST_NULL) {
+              int flag;
+              MPI_Test(&request, &flag, MPI_STATUS_IGNORE);
+          }
+#endif
+      }
+
+#ifdef USE_MPI
+      if (nprocs > 1) {
+#pragma omp master
+        {
+#ifdef INSTRUMENT
+          double start = instr_clock();
+#endif
+          MPI_Wait(&request, MPI_STATUS_IGNORE);
+#ifdef INSTRUMENT
+          double end = instr_clock();
+          instr[0].reduce += end - start;
+          instr_trace("wait", start, end);
+#endif
+        }
+#pragma omp barrier
+          // then from the vertices settled by the other processes
+#pragma omp for schedule(static)
+          for (int b = 0; b < col_n; b += KERNEL_BLOCK) {
+              BUSY_BEGIN();
+              for (int k = 0; k < n_settled; k++)
+                  if (settled[2*k] < col_lo || settled[2*k] >= col_lo + col_n)
+                      relax_kernel(distance, edges + (size_t)settled[2*k]*col_n, settled[2*k+1], b, 
+                                   b + KERNEL_BLOCK < col_n ? b + KERNEL_BLOCK : col_n 
+                                   PRED_ARG(pred) FROM_ARG(settled[2*k]));
+              BUSY_END("relax_others");
+          }
+      }
+#endif
+      if (goal == FIND_ONE_DISTANCE) {
+#pragma omp single
+          for (int k = 0; k < n_settled; k++)
+              if (settled[2*k] == destination)
+                  finished = 1;
+      }
+   }
+
+#pragma omp for schedule(static)
+   for (int v = 0; v < col_n; v++)
+       distance[v] &= ~DONE;
+ } // omp parallel
+   if (settled != mine)
+       free(settled);
+   free(mine);
+#ifdef USE_MPI
+   free(counts); free(starts);
+#endif
+}
+
+/* doWork() for engine == GPU: the steps of -e fused in one OpenMP target region each.
+   'edges' and 'distance' are copied to the device once ('target data') and stay there.
+   A step is one kernel over our vertices (teams of threads on the device): the
+   current vertex is marked done, the distances are relaxed from it and the closest
+   vertex which is not done is found, as one 64 bit minimum (distance << 32 | vertex:
+   the lower vertex on ties, as closer()), which is all that comes back to the host.
+   With MPI the processes then agree on the closest vertex overall (global_minimum()).
+   Only the final 'distance' is copied back. (Without a device, or without offload support in the
+   compiler, the target regions run on the host.) */
+void doWorkGPU()
+{
+   unsigned int *dist = distance;
+   const WEIGHT *e = edges;
+   int n = col_n, lo = col_lo;
+#ifdef _OPENMP
+   if (omp_get_num_devices() == 0 && rank == 0)
+       fprintf(stderr, "-e gpu: no offload device, the steps run on the host\n");
+#endif
+#ifdef PREDECESSORS
+   VERTEX *p = pred;
+#pragma omp target data map(to: e[0:(size_t)NV*n]) map(tofrom: dist[0:n]) map(tofrom: p[0:n])
+#else
+#pragma omp target data map(to: e[0:(size_t)NV*n]) map(tofrom: dist[0:n])
+#endif
+ {
+   struct vertex current = {0, 0};
+   BUSY_BEGIN();
+   for (int step = 0; step < NV; step++) {
+      if (current.distance >= INFINITY)
+          break;
+      if (goal == FIND_ONE_DISTANCE && current.vertex == destination)
+          break;
+      COUNT(steps, 1);
+      const int u = current.vertex, local = (int)current.vertex - lo;
+      const unsigned int d0 = current.distance;
+      uint64_t key = UINT64_MAX;
+#pragma omp target teams distribute parallel for reduction(min: key) map(tofrom: key)
+      for (int v = 0; v < n; v++) {
+          unsigned int d = dist[v];
+          if (v == local)
+              dist[v] = d = d | DONE;
+          WEIGHT w = e[(size_t)u*n + v];
+          unsigned int alternative = d0 + (w >= NO_EDGE ? INFINITY : w);
+          if ((int)alternative < (int)d) { // (false if v is done)
+              dist[v] = d = alternative;
+#ifdef PREDECESSORS
+              p[v] = u;
+#endif
+          }
+          if (d < INFINITY) {
+              uint64_t k = (uint64_t)d << 32 | (uint64_t)(v + lo);
+              key = k < key ? k : key;
+          }
+      }
+      struct vertex m = { 0, INFINITY };
+      if (key != UINT64_MAX)
+          m = (struct vertex){ (VERTEX)(key & 0xffffffffu), (unsigned int)(key >> 32) };
+      global_minimum(&m);
+      current = m;
+   }
+#pragma omp target teams distribute parallel for
+   for (int v = 0; v < n; v++)
+       dist[v] &= ~DONE;
+   BUSY_END("gpu");
+ }
+}
+
+/*  Priority queues of vertices.
+    The priority of vertex v is key[v] (usually key == distance); 
+    the vertex with the smallest key is removed first.
+    When key[v] is lowered, the vertex is pushed again (a decrease-key operation if
+    v is still in the queue).
+*/
+
+/* indexed binary heap: item[0..size-1] is a heap ordered by key[item[...]];
+   item[pos[v]] == v for each vertex v in the heap (pos[v] == -1 for the other vertices) */
+struct binary_heap {
+    VERTEX *item;
+    int *pos;
+    int size;
+};
+
+/* pairing heap: a tree (heap ordered by key) in which each vertex has a list of children.
+   (child[v]: first child of v. next[v]: next sibling of v. 
+    prev[v]: previous sibling of v, or its parent if v is a first child). */
+struct pairing_heap {
+    int *child, *next, *prev;  // -1: none
+    int root;                  // -1: the heap is empty
+    char *in_heap;
+};
+
+/* radix heap: keys are never lower than 'last' (the last key removed), so each
+   entry (key, vertex) is kept in the bucket given by the highest bit in which key
+   differs from 'last' (bucket 0: key == last).
+   Entries are never moved toward higher buckets; a vertex pushed again
+   leaves a stale entry behind, which is ignored when it is removed. */
+#define RADIX_BUCKETS 33
+struct radix_entry { unsigned int key; VERTEX vertex; };
+struct radix_heap {
+    struct radix_entry *bucket[RADIX_BUCKETS];
+    int size[RADIX_BUCKETS], room[RADIX_BUCKETS];
+    unsigned int last;
+};
+
+struct queue {
+    enum engine kind;        // HEAP, PAIRING or RADIX
+    const unsigned int *key;
+    struct binary_heap b;
+    struct pairing_heap p;
+    struct radix_heap r;
+};
+
+void *xmalloc(size_t size)
+{
+    void *p = malloc(size + 1);
+    if (p == NULL) { perror("malloc"); exit(1); }
+    return p;
+}
+
+void queue_init(struct queue *q, enum engine kind, const unsigned int *key)
+{
+    q->kind = kind;
+    q->key = key;
+    switch (kind) {
+    case HEAP:
+        q->b.item = xmalloc(NV*sizeof(VERTEX));
+        q->b.pos = xmalloc(NV*sizeof(int));
+        for (int v = 0; v < NV; v++) q->b.pos[v] = -1;
+        q->b.size = 0;
+        break;
+    case PAIRING:
+        q->p.child = xmalloc(NV*sizeof(int));
+        q->p.next = xmalloc(NV*sizeof(int));
+        q->p.prev = xmalloc(NV*sizeof(int));
+        q->p.in_heap = calloc(NV + 1, 1);
+        if (q->p.in_heap == NULL) { perror("malloc"); exit(1); }
+        q->p.root = -1;
+        break;
+    default: // RADIX
+        for (int i = 0; i < RADIX_BUCKETS; i++) {
+            q->r.bucket[i] = NULL;
+            q->r.size[i] = q->r.room[i] = 0;
+        }
+        q->r.last = 0;
+    }
+}
+
+void queue_free(struct queue *q)
+{
+    switch (q->kind) {
+    case HEAP:
+        free(q->b.item); free(q->b.pos);
+        break;
+    case PAIRING:
+        free(q->p.child); free(q->p.next); free(q->p.prev); free(q->p.in_heap);
+        break;
+    default:
+        for (int i = 0; i < RADIX_BUCKETS; i++)
+            free(q->r.bucket[i]);
+    }
+}
+
+// binary heap: move the vertex at position i up to its place
+void sift_up(struct binary_heap *h, const unsigned int *key, int i)
+{
+    VERTEX v = h->item[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        VERTEX p = h->item[parent];
+        if (key[p] < key[v] || (key[p] == key[v] && p < v))
+            break;
+        h->item[i] = p; h->pos[p] = i;
+        i = parent;
+    }
+    h->item[i] = v; h->pos[v] = i;
+}
+
+// binary heap: move the vertex at position i down to its place
+void sift_down(struct binary_heap *h, const unsigned int *key, int i)
+{
+    VERTEX v = h->item[i];
+    while (1) {
+        int c = 2*i + 1;
+        if (c >= h->size)
+            break;
+        if (c + 1 < h->size) {
+            VERTEX a = h->item[c], b = h->item[c+1];
+            if (key[b] < key[a] || (key[b] == key[a] && b < a))
+                c++;
+        }
+        VERTEX u = h->item[c];
+        if (key[v] < key[u] || (key[v] == key[u] && v < u))
+            break;
+        h->item[i] = u; h->pos[u] = i;
+        i = c;
+    }
+    h->item[i] = v; h->pos[v] = i;
+}
+
+// pairing heap: combine the trees rooted at a and b, return the new root
+int pairing_link(struct pairing_heap *h, const unsigned int *key, int a, int b)
+{
+    if (a < 0) return b;
+    if (b < 0) return a;
+    if (key[b] < key[a] || (key[b] == key[a] && b < a)) {
+        int t = a; a = b; b = t;
+    }
+    // b becomes the first child of a
+    h->next[b] = h->child[a];
+    if (h->child[a] >= 0)
+        h->prev[h->child[a]] = b;
+    h->prev[b] = a;
+    h->child[a] = b;
+    h->next[a] = h->prev[a] = -1;
+    return a;
+}
+
+// radix heap: the bucket for 'key' 
+static inline int radix_bucket(unsigned int last, unsigned int key)
+{
+    return key == last ? 0 : 32 - __builtin_clz(key ^ last);
+}
+
+void radix_add(struct radix_heap *h, unsigned int key, VERTEX v)
+{
+    int b = radix_bucket(h->last, key);
+    if (h->size[b] == h->room[b]) {
+        h->room[b] = h->room[b] ? 2*h->room[b] : 64;
+        h->bucket[b] = realloc(h->bucket[b], h->room[b]*sizeof(struct radix_entry));
+        if (h->bucket[b] == NULL) { perror("realloc"); exit(1); }
+    }
+    h->bucket[b][h->size[b]].key = key;
+    h->bucket[b][h->size[b]].vertex = v;
+    h->size[b]++;
+}
+
+/* add v to the queue, or move it to its new place if key[v] was lowered */
+void queue_push(struct queue *q, VERTEX v)
+{
+    const unsigned int *key = q->key;
+    switch (q->kind) {
+    case HEAP: {
+        struct binary_heap *h = &q->b;
+        if (h->pos[v] < 0) {
+            h->item[h->size] = v;
+            h->pos[v] = h->size++;
+        }
+        sift_up(h, key, h->pos[v]);
+        break;
+    }
+    case PAIRING: {
+        struct pairing_heap *h = &q->p;
+        if (!h->in_heap[v]) {
+            h->in_heap[v] = 1;
+            h->child[v] = h->next[v] = h->prev[v] = -1;
+            h->root = pairing_link(h, key, h->root, v);
+        } else if (v != h->root) { // cut the subtree of v and link it with the root
+            if (h->child[h->prev[v]] == v) 
+                h->child[h->prev[v]] = h->next[v];
+            else
+                h->next[h->prev[v]] = h->next[v];
+            if (h->next[v] >= 0)
+                h->prev[h->next[v]] = h->prev[v];
+            h->next[v] = h->prev[v] = -1;
+            h->root = pairing_link(h, key, h->root, v);
+        }
+        break;
+    }
+    default: 
+        radix_add(&q->r, key[v], v);
+    }
+}
+
+/* the smallest key in the queue (INFINITY if it is empty). (HEAP only) */
+unsigned int queue_min_key(const struct queue *q)
+{
+    return q->b.size > 0 ? q->key[q->b.item[0]] : INFINITY;
+}
+
+/* remove the vertex with the smallest key from the queue (into *v).
+   Returns 0 if the queue is empty. */
+int queue_pop(struct queue *q, VERTEX *v)
+{
+    const unsigned int *key = q->key;
+    switch (q->kind) {
+    case HEAP: {
+        struct binary_heap *h = &q->b;
+        if (h->size == 0)
+            return 0;
+        *v = h->item[0];
+        h->pos[*v] = -1;
+        if (--h->size > 0) {
+            h->item[0] = h->item[h->size];
+            sift_down(h, key, 0);
+        }
+        return 1;
+    }
+    case PAIRING: {
+        struct pairing_heap *h = &q->p;
+        if (h->root < 0)
+            return 0;
+        *v = h->root;
+        h->in_heap[*v] = 0;
+        /* two pass pairing of the children: link them in pairs from left to right
+           (the results are chained through 'next' in reverse order),
+           then link the results from right to left. */
+        int c = h->child[*v], pairs = -1;
+        while (c >= 0) {
+            int a = c, b = h->next[c];
+            c = (b >= 0) ? h->next[b] : -1;
+            h->next[a] = h->prev[a] = -1;
+            if (b >= 0)
+                h->next[b] = h->prev[b] = -1;
+            a = pairing_link(h, key, a, b);
+            h->next[a] = pairs;
+            pairs = a;
+        }
+        int root = -1;
+        while (pairs >= 0) {
+            int a = pairs;
+            pairs = h->next[a];
+            h->next[a] = -1;
+            root = pairing_link(h, key, root, a);
+        }
+        h->root = root;
+        return 1;
+    }
+    default: {
+        struct radix_heap *h = &q->r;
+        while (1) {
+            if (h->size[0] == 0) {
+                int b = 1;
+                while (b < RADIX_BUCKETS && h->size[b] == 0)
+                    b++;
+                if (b == RADIX_BUCKETS)
+                    return 0;
+                // the new 'last' is the smallest key in bucket b. redistribute bucket b.
+                unsigned int m = h->bucket[b][0].key;
+                for (int i = 1; i < h->size[b]; i++)
+                    if (h->bucket[b][i].key < m)
+                        m = h->bucket[b][i].key;
+                h->last = m;
+                int n = h->size[b];
+                h->size[b] = 0;
+                for (int i = 0; i < n; i++)
+                    radix_add(h, h->bucket[b][i].key, h->bucket[b][i].vertex);
+            }
+            struct radix_entry e = h->bucket[0][--h->size[0]];
+            if (e.key == key[e.vertex]) { // not a stale entry
+                *v = e.vertex;
+                return 1;
+            }
+        }
+    }
+    }
+}
+
+/* Dijkstra's algorithm with a queue of the given kind (HEAP, PAIRING or RADIX), 
+   on the graph in CSR form, from 'source' into 'dist' (which should be
+   initialized: dist[source] == 0, all other distances INFINITY).
+   Stops when vertex 'stop' is done (stop == -1: find all the distances).
+   The queue holds the vertices which are not done and whose distance is less than INFINITY. */
+void queue_dijkstra(enum engine kind, VERTEX source, unsigned int *dist, long long stop PRED_PARAM)
+{
+    struct queue q;
+    VERTEX current;
+
+    BUSY_BEGIN();
+    queue_init(&q, kind, dist);
+    queue_push(&q, source);
+    while (queue_pop(&q, &current)) {
+        if (current == stop)
+            break;
+        unsigned int d = dist[current];
+        dist[current] |= DONE;
+        COUNT(steps, 1);
+        COUNT(relax_tried, first_edge[current+1] - first_edge[current]);
+        for (uint64_t e = first_edge[current]; e < first_edge[current+1]; e++) {
+            VERTEX v = edge_to[e];
+            unsigned int alternative = d + edge_weight[e];
+            if ((int)alternative < (int)dist[v]) { // (false if v is done)
+                dist[v] = alternative;
+                SET_PRED(v, current);
+                queue_push(&q, v);
+                COUNT(relax_lowered, 1);
+            }
+        }
+    }
+    queue_free(&q);
+    clear_done(dist, NV);
+    BUSY_END("queue");
+}
+
+/* doWork() for engine == HEAP, PAIRING or RADIX (the graph is in CSR form). */
+void doWorkWithQueue()
+{
+    queue_dijkstra(engine, 0, distance, goal == FIND_ONE_DISTANCE ? destination : -1 PRED_ARG(pred));
+}
+
+/* (engine == BIDIR) the reversed graph in CSR form: the edges ... -> j are edges
+   first_in[j] .. first_in[j+1]-1; edge e is the edge edge_from[e] -> j with weight in_weight[e] */
+uint64_t *first_in;
+VERTEX *edge_from;
+unsigned int *in_weight;
+
+void reverseGraph()
+{
+    first_in = xmalloc((NV + 1)*sizeof(uint64_t));
+    edge_from = xmalloc(NE*sizeof(VERTEX));
+    in_weight = xmalloc(NE*sizeof(unsigned int));
+    memset(first_in, 0, (NV + 1)*sizeof(uint64_t));
+    for (uint64_t e = 0; e < NE; e++)
+        first_in[edge_to[e] + 1]++;
+    for (int j = 0; j < NV; j++)
+        first_in[j+1] += first_in[j];
+    uint64_t *next = xmalloc(NV*sizeof(uint64_t));
+    memcpy(next, first_in, NV*sizeof(uint64_t));
+    for (int i = 0; i < NV; i++)
+        for (uint64_t e = first_edge[i]; e < first_edge[i+1]; e++) {
+            uint64_t k = next[edge_to[e]]++;
+            edge_from[k] = i;
+            in_weight[k] = edge_weight[e];
+        }
+    free(next);
+}
+
+/* doWork() for engine == BIDIR: 'distance' holds the forward search (from vertex 0)
+   and 'back' the backward search (distances to 'destination'). Each time the search
+   whose next vertex is closer takes one step. 'best' is the length of the shortest path 
+   0 -> destination seen so far (through an edge u -> v with u done in the forward 
+   search and v reached by the backward search, or the other way); once the closest
+   vertices of the two queues together are at least 'best' away, it is the distance. */
+void doWorkBidirectional()
+{
+    struct queue forward, backward;
+    unsigned int *back = xmalloc(NV*sizeof(unsigned int));
+    unsigned int best = destination == 0 ? 0 : INFINITY;
+
+    reverseGraph();
+    for (int v = 0; v < NV; v++)
+        back[v] = INFINITY;
+    back[destination] = 0;
+    queue_init(&forward, HEAP, distance);
+    queue_init(&backward, HEAP, back);
+    queue_push(&forward, 0);
+    queue_push(&backward, destination);
+#ifdef PREDECESSORS
+    VERTEX *next = xmalloc(NV*sizeof(VERTEX)); // (backward search) the vertex after v on its path to the destination
+    VERTEX meet_from = NO_PRED, meet_to = NO_PRED; // the edge where the two halves of 'best' meet
+    for (int v = 0; v < NV; v++)
+        next[v] = NO_PRED;
+#endif
+
+    BUSY_BEGIN();
+    while (1) {
+        unsigned int f = queue_min_key(&forward), b = queue_min_key(&backward);
+        if (f >= INFINITY || b >= INFINITY || f + b >= best)
+            break;
+        int go_forward = f <= b;
+        struct queue *q = go_forward ? &forward : &backward;
+        unsigned int *dist = go_forward ? distance : back;
+        const unsigned int *other = go_forward ? back : distance;
+        const uint64_t *first = go_forward ? first_edge : first_in;
+        const VERTEX *to = go_forward ? edge_to : edge_from;
+        const unsigned int *weight = go_forward ? edge_weight : in_weight;
+        VERTEX u;
+
+        queue_pop(q, &u);
+        unsigned int d = dist[u];
+        dist[u] |= DONE;
+        COUNT(steps, 1);
+        COUNT(relax_tried, first[u+1] - first[u]);
+        for (uint64_t e = first[u]; e < first[u+1]; e++) {
+            VERTEX v = to[e];
+            unsigned int alternative = d + weight[e];
+            if ((int)alternative < (int)dist[v]) { // (false if v is done)
+                dist[v] = alternative;
+#ifdef PREDECESSORS
+                (go_forward ? pred : next)[v] = u;
+#endif
+                queue_push(q, v);
+                COUNT(relax_lowered, 1);
+            }
+            unsigned int rest = other[v] & ~DONE;
+            if (rest < INFINITY && alternative + rest < best) {
+                best = alternative + rest;
+#ifdef PREDECESSORS
+                meet_from = go_forward ? u : v;
+                meet_to = go_forward ? v : u;
+#endif
+            }
+        }
+    }
+    BUSY_END("bidir");
+#ifdef PREDECESSORS
+    // the path: the forward one to meet_from, then the backward one from meet_to
+    if (best < INFINITY && destination != 0) {
+        pred[meet_to] = meet_from;
+        for (VERTEX v = meet_to; v != destination; v = next[v])
+            pred[next[v]] = v;
+    }
+    free(next);
+#endif
+    queue_free(&forward);
+    queue_free(&backward);
+    free(back);
+    clear_done(distance, NV);
+    distance[destination] = best < INFINITY ? best : INFINITY;
+}
+
+/* exchange the graph and the reversed graph (from reverseGraph()) */
+void reverse_directions()
+{
+    uint64_t *f = first_edge; first_edge = first_in; first_in = f;
+    VERTEX *v = edge_to; edge_to = edge_from; edge_from = v;
+    unsigned int *w = edge_weight; edge_weight = in_weight; in_weight = w;
+}
+
+/* (engine == ALT) the landmarks and their distances (K == num_landmarks):
+   from_landmark[v*K + l] is the distance from landmark[l] to v and
+   to_landmark[v*K + l] is the distance from v to landmark[l]
+   (the K distances of a vertex are together: a step of the search reads them all) */
+VERTEX *landmark;
+unsigned int *from_landmark, *to_landmark;
+
+/* The landmark file: struct landmark_header, then K landmarks (4 bytes each), 
+   from_landmark and to_landmark (NV*K distances of 4 bytes each). */
+struct landmark_header {
+    char magic[4];      // "DJKA"
+    uint32_t version;   // 1
+    uint32_t nv;
+    uint32_t k;         // number of landmarks
+    uint64_t ne;
+    uint64_t checksum;  // graph_checksum() of the graph the distances belong to
+};
+
+/* a hash of the graph in CSR form */
+uint64_t graph_checksum()
+{
+    uint64_t h = NV;
+    for (int i = 0; i < NV; i++) {
+        h = splitmix64(h ^ first_edge[i+1]);
+        for (uint64_t e = first_edge[i]; e < first_edge[i+1]; e++)
+            h = splitmix64(h ^ ((uint64_t)edge_to[e] << 32 | edge_weight[e]));
+    }
+    return h;
+}
+
+/* read the landmarks from 'landmark_file'. Returns 0 if there is no such file or it
+   does not belong to this graph. */
+int readLandmarks(struct landmark_header *expected)
+{
+    int K = num_landmarks;
+    struct landmark_header h;
+    FILE *f = fopen(landmark_file, "rb");
+    if (f == NULL)
+        return 0;
+    int ok = fread(&h, sizeof(h), 1, f) == 1 && memcmp(&h, expected, sizeof(h)) == 0 &&
+             fread(landmark, sizeof(VERTEX), K, f) == K &&
+             fread(from_landmark, sizeof(unsigned int), (size_t)NV*K, f) == (size_t)NV*K &&
+             fread(to_landmark, sizeof(unsigned int), (size_t)NV*K, f) == (size_t)NV*K;
+    fclose(f);
+    if (!ok)
+        fprintf(stderr, "%s: not the landmarks of this graph, finding them again\n", landmark_file);
+    return ok;
+}
+
+void writeLandmarks(struct landmark_header *h)
+{
+    int K = num_landmarks;
+    FILE *f = fopen(landmark_file, "wb");
+    if (f == NULL ||
+        fwrite(h, sizeof(*h), 1, f) != 1 ||
+        fwrite(landmark, sizeof(VERTEX), K, f) != K ||
+        fwrite(from_landmark, sizeof(unsigned int), (size_t)NV*K, f) != (size_t)NV*K ||
+        fwrite(to_landmark, sizeof(unsigned int), (size_t)NV*K, f) != (size_t)NV*K ||
+        fclose(f) != 0) {
+        perror(landmark_file);
+        exit(1);
+    }
+}
+
+/* choose the landmarks and find their distances (or read them from 'landmark_file').
+   The first landmark is the vertex farthest from vertex 0, each next one is the vertex
+   farthest from the landmarks chosen so far (among the vertices they reach). */
+void findLandmarks()
+{
+    int K = num_landmarks;
+    landmark = xmalloc(K*sizeof(VERTEX));
+    from_landmark = xmalloc((size_t)NV*K*sizeof(unsigned int));
+    to_landmark = xmalloc((size_t)NV*K*sizeof(unsigned int));
+
+    struct landmark_header h = { {'D', 'J', 'K', 'A'}, 1, NV, K, NE, graph_checksum() };
+    if (landmark_file && readLandmarks(&h))
+        return;
+
+    unsigned int *dist = xmalloc(NV*sizeof(unsigned int));
+    unsigned int *closest = xmalloc(NV*sizeof(unsigned int)); // distance from the nearest landmark
+    for (int v = 0; v < NV; v++) {
+        dist[v] = INFINITY;
+        closest[v] = INFINITY;
+    }
+    dist[0] = 0;
+    queue_dijkstra(HEAP, 0, dist, -1 PRED_ARG(NULL));
+    unsigned int *farthest_from = dist;
+    for (int l = 0; l < K; l++) {
+        VERTEX next = 0;
+        for (int v = 1; v < NV; v++)
+            if (farthest_from[v] < INFINITY && (farthest_from[next] >= INFINITY || farthest_from[v] > farthest_from[next]))
+                next = v;
+        landmark[l] = next;
+
+        for (int v = 0; v < NV; v++)
+            dist[v] = INFINITY;
+        dist[next] = 0;
+        queue_dijkstra(HEAP, next, dist, -1 PRED_ARG(NULL));
+        for (int v = 0; v < NV; v++) {
+            from_landmark[(size_t)v*K + l] = dist[v];
+            if (dist[v] < closest[v])
+                closest[v] = dist[v];
+        }
+
+        reverse_directions(); // distances to 'next'
+        for (int v = 0; v < NV; v++)
+            dist[v] = INFINITY;
+        dist[next] = 0;
+        queue_dijkstra(HEAP, next, dist, -1 PRED_ARG(NULL));
+        reverse_directions();
+        for (int v = 0; v < NV; v++)
+            to_landmark[(size_t)v*K + l] = dist[v];
+        farthest_from = closest;
+    }
+    free(dist);
+    free(closest);
+    if (landmark_file)
+        writeLandmarks(&h);
+}
+
+/* a lower bound on the distance from v to 'destination': for each landmark L,
+   d(v,t) >= d(L,t) - d(L,v)  and  d(v,t) >= d(v,L) - d(t,L) */
+static inline unsigned int landmark_bound(VERTEX v)
+{
+    int K = num_landmarks;
+    const unsigned int *from_v = from_landmark + (size_t)v*K, *from_t = from_landmark + (size_t)destination*K;
+    const unsigned int *to_v = to_landmark + (size_t)v*K, *to_t = to_landmark + (size_t)destination*K;
+    unsigned int bound = 0;
+    for (int l = 0; l < K; l++) {
+        if (from_v[l] < INFINITY && from_t[l] < INFINITY && from_t[l] > from_v[l] + bound)
+            bound = from_t[l] - from_v[l];
+        if (to_v[l] < INFINITY && to_t[l] < INFINITY && to_v[l] > to_t[l] + bound)
+            bound = to_v[l] - to_t[l];
+    }
+    return bound;
+}
+
+/* doWork() for engine == ALT: like queue_dijkstra(), but the queue is ordered by
+   estimate[v] = distance[v] + landmark_bound(v). (The bound is consistent: it does not
+   drop by more than the weight along any edge, so a vertex is done when it is removed from
+   the queue, as in Dijkstra's algorithm.) */
+void doWorkALT()
+{
+    struct queue q;
+    VERTEX current;
+    unsigned int *estimate = xmalloc(NV*sizeof(unsigned int));
+
+    reverseGraph();
+    findLandmarks();
+    for (int v = 0; v < NV; v++)
+        estimate[v] = INFINITY;
+    estimate[0] = landmark_bound(0);
+    queue_init(&q, HEAP, estimate);
+    queue_push(&q, 0);
+    BUSY_BEGIN();
+    while (queue_pop(&q, &current)) {
+        if (current == destination)
+            break;
+        unsigned int d = distance[current];
+        distance[current] |= DONE;
+        COUNT(steps, 1);
+        COUNT(relax_tried, first_edge[current+1] - first_edge[current]);
+        for (uint64_t e = first_edge[current]; e < first_edge[current+1]; e++) {
+            VERTEX v = edge_to[e];
+            unsigned int alternative = d + edge_weight[e];
+            if ((int)alternative < (int)distance[v]) { // (false if v is done)
+                distance[v] = alternative;
+                SET_PRED(v, current);
+                estimate[v] = alternative + landmark_bound(v);
+                queue_push(&q, v);
+                COUNT(relax_lowered, 1);
+            }
+        }
+    }
+    BUSY_END("alt");
+    queue_free(&q);
+    free(estimate);
+    clear_done(distance, NV);
+}
+
+/* Dijkstra's algorithm from 'source' into 'dist' (initialized as for queue_dijkstra()) on the dense graph,
+   run by one thread: one pass per step (like update_distances_and_find_minimum()).
+   Stops when vertex 'stop' is done (stop == -1: find all the distances). */
+void dense_dijkstra(VERTEX source, unsigned int *dist, long long stop)
+{
+    struct vertex current = { source, 0 };
+    BUSY_BEGIN();
+    for (int step = 0; step < NV; step++) {
+        if (current.distance >= INFINITY || current.vertex == stop)
+            break;
+        dist[current.vertex] |= DONE;
+        COUNT(steps, 1);
+        current = relax_argmin_kernel(dist, edges + (size_t)current.vertex*NV, current.distance, 0, NV
+                                      PRED_ARG(NULL) FROM_ARG(current.vertex));
+    }
+    BUSY_END("dense");
+    clear_done(dist, NV);
+}
+
+/* remove the DONE bits from dist[0..n-1] */
+void clear_done(unsigned int *dist, int n)
+{
+    for (int v = 0; v < n; v++)
+        dist[v] &= ~DONE;
+}
+
+/* the distances from 'source' (into 'dist') */
+void single_source(VERTEX source, unsigned int *dist, long long stop)
+{
+    for (int v = 0; v < NV; v++)
+        dist[v] = INFINITY;
+    dist[source] = 0;
+    if (!sparse)
+        dense_dijkstra(source, dist, stop);
+    else
+        queue_dijkstra(engine >= HEAP && engine <= RADIX ? engine : HEAP, source, dist, stop PRED_ARG(NULL));
+}
+
+/* Batch mode: the distances from each of the sources (sources[k], or k with -A).
+   The sources are handled in rounds: in each round every thread of every process
+   handles one source (with its own 'distance'); then process 0 collects
+   and prints the results of the round, in the order of the sources. */
+void doBatch()
+{
+    if (engine == FLOYD) {
+        doFloydWarshall();
+        return;
+    }
+    int threads = omp_get_max_threads();
+    int per_round = threads * nprocs;
+    long long stop = goal == FIND_ONE_DISTANCE ? destination : -1;
+    size_t result_size = goal == FIND_ONE_DISTANCE ? 1 : NV; // what is kept of each result
+    unsigned int *dist = xmalloc((size_t)threads*NV*sizeof(unsigned int));
+    unsigned int *mine = xmalloc(threads*result_size*sizeof(unsigned int));
+    unsigned int *all = rank == 0 ? xmalloc((size_t)per_round*result_size*sizeof(unsigned int)) : NULL;
+
+    for (int first = 0; first < num_sources; first += per_round) {
+#pragma omp parallel for schedule(static, 1)
+        for (int t = 0; t < threads; t++) {
+            int k = first + rank*threads + t;
+            if (k >= num_sources)
+                continue;
+            unsigned int *d = dist + (size_t)t*NV;
+            single_source(renumbered(sources ? sources[k] : k), d, stop);
+            if (goal == FIND_ONE_DISTANCE)
+                mine[t] = d[destination];
+            else
+                memcpy(mine + (size_t)t*NV, d, NV*sizeof(unsigned int));
+        }
+#ifdef USE_MPI
+        MPI_Gather(mine, threads*result_size, MPI_UNSIGNED, all, threads*result_size, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+#else
+        memcpy(all, mine, threads*result_size*sizeof(unsigned int));
+#endif
+        if (rank != 0)
+            continue;
+        for (int k = first; k < num_sources && k < first + per_round; k++)
+            printBatchResult(sources ? sources[k] : k, all + (size_t)(k - first)*result_size);
+    }
+    free(dist); free(mine); free(all);
+}
+
+/* answer the queries of one client of the server (see -S) on socket 'fd' */
+void serveConnection(int fd, unsigned int *dist)
+{
+    FILE *in = fdopen(fd, "r"), *out = fdopen(dup(fd), "w");
+    if (in == NULL || out == NULL) { perror("fdopen"); exit(1); }
+    char line[256];
+    while (fgets(line, sizeof(line), in)) {
+        unsigned int s, d;
+        char star;
+        if (sscanf(line, "%u %u", &s, &d) == 2 && s < NV && d < NV) {
+            single_source(renumbered(s), dist, renumbered(d));
+            if (dist[renumbered(d)] >= INFINITY)
+                fprintf(out, "no path from %u to vertex %u\n", s, d);
+            else
+                fprintf(out, "distance from %u to %u is %u\n", s, d, dist[renumbered(d)]);
+        } else if (sscanf(line, "%u %c", &s, &star) == 2 && star == '*' && s < NV) {
+            char header[64];
+            single_source(renumbered(s), dist, -1);
+            sprintf(header, "distances from vertex %u:", s);
+            fprintDistances(out, header, dist);
+        } else if (strncmp(line, "quit", 4) == 0)
+            break;
+        else
+            fprintf(out, "error: expecting 'source destination', 'source *' or 'quit' (vertices 0..%d)\n", NV-1);
+        if (fflush(out) == EOF) // (the client is gone)
+            break;
+    }
+    fclose(in);
+    fclose(out);
+}
 
-   for (VERTEX v = 0; v < NV; v++) {
-#ifdef DEBUG
-      printf("finding min: v=%u, done[v]=%d distance[v]= %d  vmin.distance=%d\n",
-                    v, done[v], distance[v], vmin.distance); 
+/* Server mode (-S): the graph stays in memory and the threads of the team take turns 
+   accepting connections; each one has a 'distance' buffer of its own. */
+void doServer()
+{
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    struct stat st;
+
+    if (listener < 0) { perror("socket"); return; }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(server_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "-S: socket path is too long\n");
+        return;
+    }
+    strcpy(addr.sun_path, server_path);
+    if (lstat(server_path, &st) == 0 && S_ISSOCK(st.st_mode)) // left over from an earlier server
+        unlink(server_path);
+    if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listener, 64) < 0) {
+        perror(server_path);
+        return;
+    }
+    signal(SIGPIPE, SIG_IGN); // (a client may close its connection before it reads the answer)
+
+    int workers = omp_get_max_threads();
+    unsigned int *pool = xmalloc((size_t)workers*NV*sizeof(unsigned int));
+    fprintf(stderr, "%s: ready (%d threads)\n", server_path, workers);
+#pragma omp parallel num_threads(workers)
+  {
+    unsigned int *dist = pool + (size_t)omp_get_thread_num()*NV;
+    while (1) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd >= 0)
+            serveConnection(fd, dist);
+        else if (errno != EINTR && errno != ECONNABORTED) {
+            perror("accept");
+            exit(1);
+        }
+    }
+  }
+}
+
+/* Incremental updates (-u). The graph and 'distance' stay in memory and each batch of
+   changes of weights is followed by a repair of the distances which visits only the
+   vertices whose distance may change (in the manner of Ramalingam and Reps):
+   1. the weights are changed. A vertex whose distance may grow is 'affected': the head
+      j of an edge i -> j which was on a shortest path (distance[j] == distance[i] + old 
+      weight) and changed (if it got lighter, i may still be affected), if no shortest
+      path (with the new weights) reaches j from a vertex which is not affected; then the
+      same for the vertices the shortest paths from j reach.
+      The candidates are examined in order of distance (with a binary heap), so the
+      vertices before them on shortest paths (closer, since weights are positive) 
+      have been decided.
+   2. the distance of each affected vertex is the shortest through the edges from the
+      vertices which are not affected (or INFINITY).
+   3. the head j of an edge i -> j which got lighter gets distance[i] + new weight if
+      that is shorter.
+   4. from the affected vertices and those heads, Dijkstra's algorithm (with a binary heap)
+      lowers the distances that can be lowered.
+   The cost grows with the number of affected vertices (and their edges: NV each with a
+   dense graph), not with the size of the graph. The edges into a vertex are the column
+   of 'edges' or, in CSR form, those of reverseGraph(); a CSR graph can only change the 
+   weights of the edges it has. */
+struct update {
+    VERTEX i, j;
+    unsigned int old_weight; /* (INFINITY: no edge) the weight before this change. (If an edge
+                                changes more than once in a batch, the steps use the last weight;
+                                the other changes only add candidates and relaxations that
+                                are not needed.) */
+};
+
+/* the weight of the edge i -> j (INFINITY: no edge; with CSR, the lightest one) */
+unsigned int get_weight(VERTEX i, VERTEX j)
+{
+    if (!sparse)
+        return weight_value(edges[(size_t)i*NV + j]);
+    unsigned int w = INFINITY;
+    for (uint64_t e = first_edge[i]; e < first_edge[i+1]; e++)
+        if (edge_to[e] == j && edge_weight[e] < w)
+            w = edge_weight[e];
+    return w;
+}
+
+/* set the weight of i -> j to w (every copy of the edge, in CSR form) */
+void set_weight(VERTEX i, VERTEX j, unsigned int w)
+{
+    if (!sparse) {
+        edges[(size_t)i*NV + j] = dense_weight(w);
+        return;
+    }
+    for (uint64_t e = first_edge[i]; e < first_edge[i+1]; e++)
+        if (edge_to[e] == j)
+            edge_weight[e] = w;
+    for (uint64_t e = first_in[j]; e < first_in[j+1]; e++)
+        if (edge_from[e] == i)
+            in_weight[e] = w;
+}
+
+/* the shortest distance of v through an edge from a vertex which is not affected 
+   (that vertex is '*from', NO_PRED if there is none) */
+unsigned int best_from_unaffected(VERTEX v, const unsigned char *affected, VERTEX *from)
+{
+    unsigned int best = INFINITY;
+    *from = NO_PRED;
+    if (!sparse) {
+        for (int k = 0; k < NV; k++) {
+            unsigned int w = weight_value(edges[(size_t)k*NV + v]);
+            if (!affected[k] && w < INFINITY && distance[k] + w < best)
+                best = distance[k] + w, *from = k;
+        }
+    } else {
+        for (uint64_t e = first_in[v]; e < first_in[v+1]; e++) {
+            VERTEX k = edge_from[e];
+            if (!affected[k] && in_weight[e] < INFINITY && distance[k] + in_weight[e] < best)
+                best = distance[k] + in_weight[e], *from = k;
+        }
+    }
+    COUNT(scanned, sparse ? first_in[v+1] - first_in[v] : NV);
+    return best;
+}
+
+/* repair 'distance' after the changes u[0..n-1] (steps 1-4 above); 'affected' is all 0
+   and 'list' has room for NV vertices. Returns the number of affected vertices. */
+int repairDistances(const struct update *u, int n, struct queue *q, unsigned char *affected, VERTEX *list)
+{
+    int n_affected = 0;
+    // 1. (the candidates are in the heap, by distance)
+    for (int k = 0; k < n; k++)
+        if (get_weight(u[k].i, u[k].j) != u[k].old_weight && u[k].j != 0 && distance[u[k].j] < INFINITY &&
+            distance[u[k].i] + u[k].old_weight == distance[u[k].j])
+            queue_push(q, u[k].j);
+    VERTEX v, from;
+    while (queue_pop(q, &v)) {
+        if (affected[v])
+            continue;
+        if (best_from_unaffected(v, affected, &from) == distance[v]) {
+            SET_PRED(v, from); // (the edge from its predecessor may have changed)
+            continue;
+        }
+        affected[v] = 1;
+        list[n_affected++] = v;
+        if (!sparse) {
+            const WEIGHT *row = edges + (size_t)v*NV;
+            for (int x = 0; x < NV; x++)
+                if (!affected[x] && weight_value(row[x]) < INFINITY && distance[v] + weight_value(row[x]) == distance[x])
+                    queue_push(q, x);
+        } else
+            for (uint64_t e = first_edge[v]; e < first_edge[v+1]; e++)
+                if (!affected[edge_to[e]] && distance[v] + edge_weight[e] == distance[edge_to[e]])
+                    queue_push(q, edge_to[e]);
+    }
+    // 2. (the new distances are found first: best_from_unaffected() reads only unaffected ones)
+    unsigned int *best = xmalloc(n_affected*sizeof(unsigned int));
+    VERTEX *best_from = xmalloc(n_affected*sizeof(VERTEX));
+    for (int k = 0; k < n_affected; k++)
+        best[k] = best_from_unaffected(list[k], affected, &best_from[k]);
+    for (int k = 0; k < n_affected; k++) {
+        distance[list[k]] = best[k];
+        SET_PRED(list[k], best_from[k]);
+        affected[list[k]] = 0;
+        if (best[k] < INFINITY)
+            queue_push(q, list[k]);
+    }
+    free(best);
+    free(best_from);
+    // 3.
+    for (int k = 0; k < n; k++) {
+        unsigned int w = get_weight(u[k].i, u[k].j);
+        if (w < u[k].old_weight && distance[u[k].i] + w < distance[u[k].j]) {
+            distance[u[k].j] = distance[u[k].i] + w;
+            SET_PRED(u[k].j, u[k].i);
+            queue_push(q, u[k].j);
+        }
+    }
+    // 4.
+    while (queue_pop(q, &v)) {
+        unsigned int d = distance[v];
+        if (!sparse) {
+            const WEIGHT *row = edges + (size_t)v*NV;
+            for (int x = 0; x < NV; x++)
+                if (d + weight_value(row[x]) < distance[x]) {
+                    distance[x] = d + weight_value(row[x]);
+                    SET_PRED(x, v);
+                    queue_push(q, x);
+                    COUNT(relax_lowered, 1);
+                }
+        } else
+            for (uint64_t e = first_edge[v]; e < first_edge[v+1]; e++)
+                if (d + edge_weight[e] < distance[edge_to[e]]) {
+                    distance[edge_to[e]] = d + edge_weight[e];
+                    SET_PRED(edge_to[e], v);
+                    queue_push(q, edge_to[e]);
+                    COUNT(relax_lowered, 1);
+                }
+    }
+    return n_affected;
+}
+
+/* (-u) after the first solve: read the batches of changes from 'updates_file' and, after
+   each one, repair the distances and write them (after the line "after update k:").
+   The lines of a batch are 
+       i j w     the edge i -> j gets weight w (a dense graph may get a new edge)
+       i j *     the edge i -> j is removed
+   and the batches are separated by empty lines (or the end of the file). With -T the 
+   number of changes, of affected vertices, and the time of each repair are written to the
+   standard error ("update k: changes=... affected=... repair=..."). */
+void doUpdates()
+{
+    FILE *f = updates_in;
+    if (sparse)
+        reverseGraph();
+    struct queue q;
+    queue_init(&q, HEAP, distance);
+    unsigned char *affected = calloc(NV + 1, 1);
+    VERTEX *list = xmalloc(NV*sizeof(VERTEX));
+    int room = 64, n = 0, batch_no = 0, lineno = 0, more = 1;
+    struct update *u = xmalloc(room*sizeof(struct update));
+    char line[256];
+    if (affected == NULL) { perror("malloc"); exit(1); }
+    while (more) {
+        more = fgets(line, sizeof(line), f) != NULL;
+        lineno++;
+        unsigned int i, j, w;
+        char star;
+        if (more && sscanf(line, "%u %u %u", &i, &j, &w) == 3 && w < INFINITY)
+            ;
+        else if (more && sscanf(line, "%u %u %c", &i, &j, &star) == 3 && star == '*')
+            w = INFINITY;
+        else if (!more || strspn(line, " \t\r\n") == strlen(line)) { // the end of a batch
+            if (n == 0)
+                continue;
+            double t = now();
+            int n_affected = repairDistances(u, n, &q, affected, list);
+            t = now() - t;
+            phase_time[SOLVE] += t;
+            if (timing)
+                fprintf(stderr, "update %d: changes=%d affected=%d repair=%.6f\n", batch_no, n, n_affected, t);
+            char header[64];
+            sprintf(header, "after update %d:", batch_no++);
+            t = now();
+            printResult(header);
+            phase_time[OUTPUT] += now() - t;
+            n = 0;
+            continue;
+        } else {
+            fprintf(stderr, "%s: line %d: expecting 'i j weight' or 'i j *'\n", updates_file, lineno);
+            exit(2);
+        }
+        if (i >= NV || j >= NV || !weight_fits(w)) {
+            fprintf(stderr, "%s: line %d: illegal vertex or weight\n", updates_file, lineno);
+            exit(4);
+        }
+        unsigned int old = get_weight(renumbered(i), renumbered(j));
+        if (sparse && old >= INFINITY) {
+            fprintf(stderr, "%s: line %d: the CSR graph has no edge %u -> %u\n", updates_file, lineno, i, j);
+            exit(4);
+        }
+        i = renumbered(i);
+        j = renumbered(j);
+        set_weight(i, j, w);
+        if (n == room) {
+            room *= 2;
+            u = realloc(u, room*sizeof(struct update));
+            if (u == NULL) { perror("realloc"); exit(1); }
+        }
+        u[n++] = (struct update){ i, j, old };
+    }
+    fclose(f);
+    queue_free(&q);
+    free(affected); free(list); free(u);
+}
+
+/* (batch mode) write the distances from 's' ('result' is only the distance 
+   to the destination when goal == FIND_ONE_DISTANCE) */
+void printBatchResult(VERTEX s, unsigned int *result)
+{
+    double t = now();
+    if (goal == FIND_ONE_DISTANCE) {
+        if (*result >= INFINITY)
+            printf("no path from %u to vertex %u\n", s, destination_arg);
+        else 
+            printf("distance from %u to %u is %u\n", s, destination_arg, *result);
+    } else {
+        char header[64];
+        sprintf(header, "distances from vertex %u:", s);
+        distance = result;
+        printDistances(header);
+    }
+    phase_time[OUTPUT] += now() - t;
+}
+
+#ifndef FW_TILE
+#define FW_TILE 64 // tiles of 64 x 64 distances (16 KB) fit in the L1 or L2 cache
 #endif
-      if (!done[v] && distance[v] < vmin.distance)  {
-         vmin.distance = distance[v];
-         vmin.vertex = v;
-      }
-   }
-   return vmin; // note: when vmin.distance is INFINITY, vmin.vertex is meaningless
+
+/* the part of round 'kb' of the Floyd-Warshall algorithm for the tile (ib,jb):
+   d[i][j] = min(d[i][j], d[i][k] + d[k][j]) for all i, j in the tile and
+   k in tile-row 'kb' (in order of k) */
+void fw_tile(unsigned int *d, int ib, int jb, int kb)
+{
+    int i_end = (ib+1)*FW_TILE < NV ? (ib+1)*FW_TILE : NV;
+    int j_end = (jb+1)*FW_TILE < NV ? (jb+1)*FW_TILE : NV;
+    int k_end = (kb+1)*FW_TILE < NV ? (kb+1)*FW_TILE : NV;
+    for (int k = kb*FW_TILE; k < k_end; k++) {
+        const unsigned int *row_k = d + (size_t)k*NV;
+        for (int i = ib*FW_TILE; i < i_end; i++) {
+            unsigned int *row_i = d + (size_t)i*NV;
+            unsigned int d_ik = row_i[k];
+            if (d_ik >= INFINITY)
+                continue;
+            for (int j = jb*FW_TILE; j < j_end; j++) {
+                unsigned int alternative = d_ik + row_k[j];
+                if (alternative < row_i[j])
+                    row_i[j] = alternative;
+            }
+        }
+    }
+}
+
+/* first row of tiles of process 'r' (the rows of tiles are divided among the 
+   processes like the vertices in block_start()) */
+int tile_block_start(int r, int nb)
+{
+    return (int)((long long)r * nb / nprocs);
 }
 
+/* batch mode, engine == FLOYD: all the distances (in place in 'edges' if it can) 
+   (every process has the whole matrix but updates only its own rows of tiles).
+   Then process 0 writes the rows of the sources. */
+void doFloydWarshall()
+{
+    /* the distances: in place in 'edges' if the weights are 32 bits */
+    unsigned int *d = sizeof(WEIGHT) == sizeof(unsigned int) ? (unsigned int *)edges 
+                                                             : xmalloc((size_t)NV*NV*sizeof(unsigned int));
+    int nb = (NV + FW_TILE - 1) / FW_TILE; // number of rows (and columns) of tiles
+    int my_lo = tile_block_start(rank, nb), my_hi = tile_block_start(rank+1, nb);
 
-/* Update distances for  vertices.
-   For each vertex v (which is not 'done' yet), ask whether a shorter path to v 
-   exists, through vertex 'current'. 
-*/ 
-void update_distances(struct vertex current)
+    int my_end = my_hi*FW_TILE < NV ? my_hi*FW_TILE : NV; // (the last tile may be smaller)
+#pragma omp parallel for schedule(static)
+    for (int i = my_lo*FW_TILE; i < my_end; i++) 
+        for (int j = 0; j < NV; j++)
+            d[(size_t)i*NV + j] = i == j ? 0 : weight_value(edges[(size_t)i*NV + j]);
+
+#pragma omp parallel
+  {
+    for (int kb = 0; kb < nb; kb++) {
+        int owner = (int)(((long long)(kb+1)*nprocs - 1) / nb); // the process of tile-row kb
+        if (rank == owner) {
+#pragma omp single
+            fw_tile(d, kb, kb, kb);
+            // (implicit barrier: the other tiles of row kb need tile (kb,kb))
+#pragma omp for schedule(dynamic)
+            for (int jb = 0; jb < nb; jb++)
+                if (jb != kb)
+                    fw_tile(d, kb, jb, kb);
+        }
+#ifdef USE_MPI
+        if (nprocs > 1) {
+#pragma omp master
+            {
+                int rows = (kb+1)*FW_TILE < NV ? FW_TILE : NV - kb*FW_TILE;
+                MPI_Bcast(d + (size_t)kb*FW_TILE*NV, rows*NV, MPI_UNSIGNED, owner, MPI_COMM_WORLD);
+            }
+#pragma omp barrier
+        }
+#endif
+        /* the tile (ib,kb) first: the other tiles of row ib need it */
+#pragma omp for schedule(dynamic)
+        for (int ib = my_lo; ib < my_hi; ib++) {
+            if (ib == kb)
+                continue;
+            fw_tile(d, ib, kb, kb);
+            for (int jb = 0; jb < nb; jb++)
+                if (jb != kb)
+                    fw_tile(d, ib, jb, kb);
+        }
+    }
+  }
+
+#ifdef USE_MPI
+    /* process 0 collects the rows of tiles of the other processes */
+    for (int r = 1; r < nprocs; r++) {
+        int lo = tile_block_start(r, nb)*FW_TILE, hi = tile_block_start(r+1, nb)*FW_TILE;
+        if (hi > NV) hi = NV;
+        for (int i = lo; i < hi; i += FW_TILE) {
+            int rows = i + FW_TILE < hi ? FW_TILE : hi - i;
+            if (rank == r)
+                MPI_Send(d + (size_t)i*NV, rows*NV, MPI_UNSIGNED, 0, 0, MPI_COMM_WORLD);
+            else if (rank == 0)
+                MPI_Recv(d + (size_t)i*NV, rows*NV, MPI_UNSIGNED, r, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        }
+    }
+#endif
+    if (rank != 0)
+        return;
+    for (int k = 0; k < num_sources; k++) {
+        VERTEX s = sources ? sources[k] : k;
+        printBatchResult(s, d + (size_t)s*NV + (goal == FIND_ONE_DISTANCE ? destination : 0));
+    }
+}
+
+/*  Delta-stepping (Meyer and Sanders).
+    A vertex whose distance (so far) is d is kept in bucket number d/delta.
+    The buckets are handled in increasing order. Handling a bucket means:
+    relax the light edges (weight <= delta) of all its vertices in parallel, which may
+    insert vertices back into the same bucket, until the bucket stays empty, and then relax
+    the heavy edges (weight > delta) of all the vertices that were removed from it.
+    Since all the distances so far are less than (i+1)*delta + max_weight when bucket i is
+    handled, the buckets are kept in a circular array of max_weight/delta + 2 buckets.
+    The buckets may contain stale entries (vertices whose distance has since 
+    moved them to a lower bucket); these are ignored.
+*/
+struct bucket {
+    VERTEX *v;
+    size_t n, room;
+};
+
+void bucket_add(struct bucket *b, VERTEX v)
 {
-   for (VERTEX v = 1; v < NV; v++) 
-       if (!done[v]) {
-           unsigned int alternative = current.distance + edges[current.vertex*NV+v];
-           // printf("alternative: %d\n", alternative);
-           if (alternative < distance[v])
-               distance[v] = alternative; 
-       }
-   // print_distances("distances:");
+    if (b->n == b->room) {
+        b->room = b->room ? 2*b->room : 64;
+        b->v = realloc(b->v, b->room*sizeof(VERTEX));
+        if (b->v == NULL) { perror("realloc"); exit(1); }
+    }
+    b->v[b->n++] = v;
+}
+
+/* distance[v] = min(distance[v], d) (atomically). Returns 1 if distance[v] was lowered */
+static inline int lower_distance(VERTEX v, unsigned int d)
+{
+    unsigned int old = __atomic_load_n(&distance[v], __ATOMIC_RELAXED);
+    while (d < old)
+        if (__atomic_compare_exchange_n(&distance[v], &old, d, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            return 1;
+    return 0;
+}
+
+/* relax the edges u -> ... with weight in [min_w, max_w].
+   The vertices whose distance was lowered are added to 'changed'. */
+static inline void relax_edges(VERTEX u, unsigned int min_w, unsigned int max_w, struct bucket *changed)
+{
+    unsigned int du = __atomic_load_n(&distance[u], __ATOMIC_RELAXED);
+    for (uint64_t e = first_edge[u]; e < first_edge[u+1]; e++) {
+        unsigned int w = edge_weight[e];
+        if (w < min_w || w > max_w)
+            continue;
+        COUNT(relax_tried, 1);
+        if (lower_distance(edge_to[e], du + w)) {
+            bucket_add(changed, edge_to[e]);
+            COUNT(relax_lowered, 1);
+        }
+    }
+}
+
+void doWorkDeltaStepping()
+{
+    unsigned int max_w = 1;
+    for (uint64_t e = 0; e < NE; e++)
+        if (edge_weight[e] > max_w)
+            max_w = edge_weight[e];
+    if (delta == 0) {
+        unsigned int avg_degree = NV > 0 ? NE / NV : 0;
+        delta = avg_degree > 0 ? max_w / avg_degree : max_w;
+        if (delta == 0)
+            delta = 1;
+    }
+    const unsigned int nb = max_w / delta + 2; // number of buckets
+    struct bucket *buckets = calloc(nb, sizeof(struct bucket));
+    VERTEX *frontier = xmalloc(NV*sizeof(VERTEX)); // vertices of the current bucket in this round
+    VERTEX *removed = xmalloc(NV*sizeof(VERTEX));  // all the vertices removed from the current bucket
+    unsigned int *in_frontier = calloc(NV + 1, sizeof(unsigned int)); // round in which v was last in 'frontier'
+    unsigned int *in_removed = calloc(NV + 1, sizeof(unsigned int));  // (bucket number+1) when v was last in 'removed'
+    if (buckets == NULL || in_frontier == NULL || in_removed == NULL) { perror("malloc"); exit(1); }
+
+    unsigned int current = 0;  // number of the bucket being handled
+    unsigned int round = 0;
+    size_t n_frontier = 0, n_removed = 0, waiting = 0; // waiting: number of entries in all the buckets
+    int finished = 0;
+
+    bucket_add(&buckets[0], 0);
+    waiting = 1;
+
+#pragma omp parallel
+ {
+    struct bucket changed = {NULL, 0, 0}; // vertices whose distance this thread lowered
+
+    while (1) {
+#pragma omp single
+     {
+        // find the next bucket which is not empty
+        unsigned int k = 0;
+        while (waiting > 0 && k < nb && buckets[(current + k) % nb].n == 0)
+            k++;
+        current += k;
+        finished = waiting == 0 || k == nb ||
+            (goal == FIND_ONE_DISTANCE && distance[destination] < (unsigned long long)current*delta);
+        n_removed = 0;
+     }
+        if (finished)
+            break;
+
+        // light edges, until the bucket stays empty
+        while (1) {
+#pragma omp single
+         {
+            struct bucket *b = &buckets[current % nb];
+            round++;
+            COUNT(steps, 1);
+#ifdef INSTRUMENT
+            instr_step = round;
+#endif
+            n_frontier = 0;
+            for (size_t k = 0; k < b->n; k++) {
+                VERTEX v = b->v[k];
+                if (distance[v] / delta != current || in_frontier[v] == round)
+                    continue; // stale or duplicate entry
+                in_frontier[v] = round;
+                frontier[n_frontier++] = v;
+                if (in_removed[v] != current + 1) {
+                    in_removed[v] = current + 1;
+                    removed[n_removed++] = v;
+                }
+            }
+            waiting -= b->n;
+            b->n = 0;
+         }
+            if (n_frontier == 0)
+                break;
+#pragma omp for schedule(dynamic, 64)
+            for (size_t k = 0; k < n_frontier; k++) {
+                BUSY_BEGIN();
+                relax_edges(frontier[k], 0, delta, &changed);
+                BUSY_END("light");
+            }
+#pragma omp critical
+            {
+                for (size_t k = 0; k < changed.n; k++)
+                    bucket_add(&buckets[(distance[changed.v[k]] / delta) % nb], changed.v[k]);
+                waiting += changed.n;
+            }
+            changed.n = 0;
+#pragma omp barrier
+        }
+
+        // heavy edges of all the vertices removed from the bucket
+#pragma omp for schedule(dynamic, 64)
+        for (size_t k = 0; k < n_removed; k++) {
+            BUSY_BEGIN();
+            relax_edges(removed[k], delta + 1, INFINITY, &changed);
+            BUSY_END("heavy");
+        }
+#pragma omp critical
+        {
+            for (size_t k = 0; k < changed.n; k++)
+                bucket_add(&buckets[(distance[changed.v[k]] / delta) % nb], changed.v[k]);
+            waiting += changed.n;
+        }
+        changed.n = 0;
+#pragma omp barrier
+#pragma omp single
+        current++;
+    }
+    free(changed.v);
+ } // omp parallel
+
+    for (unsigned int i = 0; i < nb; i++)
+        free(buckets[i].v);
+    free(buckets); free(frontier); free(removed); free(in_frontier); free(in_removed);
 }
 
 /*  Read the standard input  containing the description of a graph
@@ -184,22 +3755,117 @@ void update_distances(struct vertex current)
     A weight appears in the input as a positive integer or as a '*'  character.
     If a '*' appears in the input then the corresponding entry in 'edges' is initialized to
     INFINITY.
+    If 'sparse' is 1, 'first_edge', 'edge_to' and 'edge_weight' are initialized instead of 'edges'
+    (and the '*' entries are not stored).
+    If the input starts with 's' it is a list of edges (see readEdgeList())
+
+    The input is not read with stdio: if the standard input is a file it is mapped
+    into memory (mmap), otherwise it is read in large chunks; the numbers are 
+    converted by read_number().
 */
 int lineno = 1; // current input line number
 
+#define INPUT_CHUNK (4 << 20)      // size of the chunks read when the input is not a file
+const unsigned char *in_pos;       // next input character
+const unsigned char *in_end;       // end of the input available in memory
+unsigned char *in_buffer;          // the chunk (NULL if the input is mapped into memory)
+int in_mapped;                     // 1 if the whole input is mapped into memory
+
 void skip_white_space();
+void readEdgeList();
+void add_edge(VERTEX j, unsigned int w);
+
+/* prepare to read the standard input */
+void open_input()
+{
+    struct stat st;
+    if (fstat(0, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        /* private writable mapping: the graph may be changed in memory (copy on write) */
+        void *p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, 0, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, st.st_size, MADV_SEQUENTIAL);
+            in_pos = p;
+            in_end = in_pos + st.st_size;
+            in_mapped = 1;
+            return;
+        }
+    }
+    in_buffer = malloc(INPUT_CHUNK);
+    if (in_buffer == NULL) { perror("malloc"); exit(1); }
+    in_pos = in_end = in_buffer;
+}
+
+/* read the next chunk of the input. Returns 0 at the end of the input. */
+int fill_input()
+{
+    if (in_mapped)
+        return 0;
+    ssize_t n;
+    do 
+        n = read(0, in_buffer, INPUT_CHUNK);
+    while (n < 0 && errno == EINTR);
+    if (n < 0) { perror("read"); exit(2); }
+    in_pos = in_buffer;
+    in_end = in_buffer + n;
+    return n > 0;
+}
+
+/* the next input character (EOF at the end of the input); it is not consumed */
+static inline int peek_char()
+{
+    if (in_pos == in_end && !fill_input())
+        return EOF;
+    return *in_pos;
+}
+
+/* read an unsigned number (a sequence of digits). 
+   Returns 0 (and reads nothing) if the next character is not a digit, or if the number is too large. */
+static inline int read_number(uint64_t *x, uint64_t max)
+{
+    int c = peek_char();
+    if (c < '0' || c > '9')
+        return 0;
+    uint64_t n = 0;
+    do {
+        n = n*10 + (c - '0');
+        if (n > max)
+            return 0;
+        in_pos++;
+        c = peek_char();
+    } while (c >= '0' && c <= '9');
+    *x = n;
+    return 1;
+}
 
 void readGraph() {
     
     int c;
-    unsigned int w;
-    int count_w = 0; // number of entries read in so far
+    uint64_t w;
+    uint64_t count_w = 0; // number of entries read in so far
+
+    open_input();
+    if (peek_char() == 'D' && in_end - in_pos >= 4 && memcmp(in_pos, "DJKG", 4) == 0) {
+        readBinaryGraph();
+        return;
+    }
+    skip_white_space();
+    if (peek_char() == 's') {
+        in_pos++;
+        readEdgeList();
+        return;
+    }
 
     /* First number in the input is the number of vertices. Use it to initialize 'NV' */
         
-    if (scanf("%d", &NV) == 1) {
-         edges = (unsigned int *)malloc(NV * NV * sizeof(unsigned int));
-         if (edges == NULL) { perror("malloc"); exit(1); }
+    if (read_number(&w, 0x7fffffff)) {
+         NV = w;
+         if (sparse) {
+             first_edge = (uint64_t *)calloc(NV + 1, sizeof(uint64_t));
+             if (first_edge == NULL) { perror("malloc"); exit(1); }
+         } else {
+             edges = alloc_edges(NV, NV);
+             first_touch(edges, NV, NV);
+         }
     } else {
         fprintf(stderr, 
                 "line %d: first item in the input should be the number of vertices in the graph\n",
@@ -207,26 +3873,38 @@ void readGraph() {
         exit(1);
     }
 
-    unsigned int *next_entry = edges;
+    WEIGHT *next_entry = edges;
+    const uint64_t nw = (uint64_t)NV * NV; // number of weights
 
     while (1) {
         skip_white_space();
-        c = getchar();
+        c = peek_char();
         if (c == EOF) 
             break;
-        if (count_w >= NV*NV) {
+        if (count_w >= nw) {
              fprintf(stderr, "line %d: too many weights (expecting %d*%d weights)\n",
                               lineno, NV, NV);
             exit(5);
         }
         if (c == '*') {
-             *next_entry++ = INFINITY;
+             in_pos++;
+             if (!sparse)
+                 *next_entry++ = NO_EDGE;
              count_w++;
         } else {
-             ungetc(c, stdin);
-             int r = scanf("%u", &w);
-             if (r == 1) { // a number (weight) was read
-                *next_entry++ = w;
+             if (read_number(&w, UINT32_MAX)) { // a number (weight) was read
+                if (!sparse) {
+                    if (!weight_fits(w)) {
+                        fprintf(stderr, "line %d: weight %" PRIu64 " does not fit in %d bits\n", 
+                                        lineno, w, WEIGHT_BITS);
+                        exit(2);
+                    }
+                    *next_entry++ = dense_weight(w);
+                }
+                else if (w < INFINITY) {
+                    add_edge(count_w % NV, w);
+                    first_edge[count_w / NV + 1] = NE;
+                }
                 count_w++;
              } else {
                   fprintf(stderr, "line %d: error in input\n", lineno);
@@ -235,48 +3913,640 @@ void readGraph() {
         }
         
     }
-    if (count_w != NV*NV) {
-        fprintf(stderr, "%d weights appear in the input (expected\
- %d weights because number of vertices is %d)\n", 
-         count_w, NV*NV, NV);
+    if (count_w != nw) {
+        fprintf(stderr, "%" PRIu64 " weights appear in the input (expected\
+ %" PRIu64 " weights because number of vertices is %d)\n", 
+         count_w, nw, NV);
          exit(6);
     }
+    if (sparse) // rows without edges
+        for (int i = 1; i <= NV; i++)
+            if (first_edge[i] < first_edge[i-1])
+                first_edge[i] = first_edge[i-1];
+}
+
+/* the k'th weight in an array of weights of 'size' bytes each */
+static inline unsigned int binary_weight(const unsigned char *p, int size, uint64_t k)
+{
+    if (size == 1)
+        return p[k] == 0xff ? INFINITY : p[k];
+    if (size == 2) {
+        uint16_t w;
+        memcpy(&w, p + 2*k, 2);
+        return w == 0xffff ? INFINITY : w;
+    }
+    uint32_t w;
+    memcpy(&w, p + 4*k, 4);
+    return w >= INFINITY ? INFINITY : w;
+}
+
+/*  Read a binary graph file (see struct graph_header) from the standard input.
+    If the input is mapped into memory and the weights are 4 bytes (WEIGHT_BITS/8 bytes
+    for 'edges'), 'edges' (or the CSR arrays) point straight into the mapped file. Otherwise the weights are converted into 'edges'.
+    With -s a dense file is converted to CSR form.
+*/
+void readBinaryGraph()
+{
+    const unsigned char *base;
+    unsigned char *all = NULL; // (not mapped) the copy of the input
+    size_t size;
+
+    const uint16_t one = 1;
+    if (*(const uint8_t *)&one != 1) {
+        fprintf(stderr, "binary graph files can only be read on little endian machines\n");
+        exit(2);
+    }
+    if (in_mapped) {
+        base = in_pos;
+        size = in_end - in_pos;
+    } else { // read the whole input into memory
+        size_t room = INPUT_CHUNK;
+        size = in_end - in_pos;
+        all = malloc(room);
+        if (all == NULL) { perror("malloc"); exit(1); }
+        memcpy(all, in_pos, size);
+        while (fill_input()) {
+            if (size + (in_end - in_pos) > room) {
+                room = 2*room;
+                all = realloc(all, room);
+                if (all == NULL) { perror("realloc"); exit(1); }
+            }
+            memcpy(all + size, in_pos, in_end - in_pos);
+            size += in_end - in_pos;
+        }
+        base = all;
+    }
+
+    struct graph_header h;
+    if (size < sizeof(h)) {
+        fprintf(stderr, "binary graph file: header is too short\n");
+        exit(2);
+    }
+    memcpy(&h, base, sizeof(h));
+    int ws = h.weight_size;
+    if (h.version != 1 || (h.layout != GRAPH_DENSE && h.layout != GRAPH_CSR) ||
+        (ws != 1 && ws != 2 && ws != 4) || h.nv > 0x7fffffff) {
+        fprintf(stderr, "binary graph file: unknown version, layout or weight size\n");
+        exit(2);
+    }
+    NV = h.nv;
+    const unsigned char *data = base + sizeof(h);
+    size -= sizeof(h);
+
+    if (h.layout == GRAPH_DENSE) {
+        uint64_t nw = (uint64_t)NV * NV;
+        if (nw > size / ws) {
+            fprintf(stderr, "binary graph file is truncated (expecting %" PRIu64 " weights)\n", nw);
+            exit(6);
+        }
+        if (sparse) {
+            first_edge = (uint64_t *)xmalloc((NV + 1)*sizeof(uint64_t));
+            first_edge[0] = 0;
+            for (int i = 0; i < NV; i++) {
+                for (int j = 0; j < NV; j++) {
+                    unsigned int w = binary_weight(data, ws, (uint64_t)i*NV + j);
+                    if (w < INFINITY)
+                        add_edge(j, w);
+                }
+                first_edge[i+1] = NE;
+            }
+        } else if (ws == sizeof(WEIGHT) && !huge_pages) {
+            edges = (WEIGHT *)data;
+            edges_mapped = 1;
+        } else { // (converted or copied by the threads that will use the columns, see first_touch())
+            edges = alloc_edges(NV, NV);
+#pragma omp parallel for schedule(static)
+            for (int b = 0; b < NV; b += KERNEL_BLOCK)
+                for (uint64_t i = 0; i < NV; i++)
+                    for (uint64_t k = i*NV + b; k < i*NV + NV && k < i*NV + b + KERNEL_BLOCK; k++) {
+                        unsigned int w = binary_weight(data, ws, k);
+                        if (!weight_fits(w)) {
+                            fprintf(stderr, "binary graph file: weight %u does not fit in %d bits\n", w, WEIGHT_BITS);
+                            exit(2);
+                        }
+                        edges[k] = dense_weight(w);
+                    }
+        }
+        if (edges_mapped)
+            input_copy = all;
+        else
+            free(all);
+        return;
+    }
+
+    // GRAPH_CSR
+    // (compared without multiplying by NE, which comes from the file and may overflow)
+    NE = h.ne;
+    if (size < (NV + 1)*sizeof(uint64_t) ||
+        NE > (size - (NV + 1)*sizeof(uint64_t)) / (sizeof(VERTEX) + ws)) {
+        fprintf(stderr, "binary graph file is truncated (expecting %" PRIu64 " edges)\n", NE);
+        exit(6);
+    }
+    sparse = 1;
+    first_edge = (uint64_t *)data;
+    for (int i = 0; i < NV; i++)
+        if (first_edge[i] > first_edge[i+1]) {
+            fprintf(stderr, "binary graph file: bad CSR offsets (vertex %d)\n", i);
+            exit(2);
+        }
+    if (first_edge[0] != 0 || first_edge[NV] != NE) {
+        fprintf(stderr, "binary graph file: bad CSR offsets\n");
+        exit(2);
+    }
+    edge_to = (VERTEX *)(data + (NV + 1)*sizeof(uint64_t));
+    const unsigned char *weights = data + (NV + 1)*sizeof(uint64_t) + NE*sizeof(VERTEX);
+    if (ws == sizeof(unsigned int)) {
+        edge_weight = (unsigned int *)weights;
+    } else {
+        edge_weight = converted_weight = (unsigned int *)xmalloc(NE*sizeof(unsigned int));
+        for (uint64_t e = 0; e < NE; e++)
+            edge_weight[e] = binary_weight(weights, ws, e);
+    }
+    edges_mapped = 1;
+    input_copy = all;
+    for (uint64_t e = 0; e < NE; e++) {
+        if (edge_to[e] >= NV) {
+            fprintf(stderr, "binary graph file: bad vertex %u\n", edge_to[e]);
+            exit(2);
+        }
+        if (edge_weight[e] >= INFINITY) {
+            fprintf(stderr, "binary graph file: bad weight %u\n", edge_weight[e]);
+            exit(2);
+        }
+    }
+}
+
+#ifdef USE_MPI
+/* the process whose block has vertex v */
+int block_owner(VERTEX v)
+{
+    int r = (long long)v * nprocs / NV;
+    while (r + 1 < nprocs && block_start(r+1) <= v)
+        r++;
+    while (block_start(r) > v)
+        r--;
+    return r;
+}
+
+/* MPI_File_read_at() of 'count' items (count may be more than an int can hold) */
+void read_at_big(MPI_File fh, MPI_Offset offset, void *buf, size_t count, MPI_Datatype type, size_t item_size)
+{
+    const size_t chunk = 1 << 28;
+    for (size_t k = 0; k < count; k += chunk)
+        MPI_File_read_at(fh, offset + k*item_size, (char *)buf + k*item_size, 
+                         count - k < chunk ? count - k : chunk, type, MPI_STATUS_IGNORE);
+}
+
+/* (readGraphParallel) the columns col_lo .. col_lo+col_n-1 of a dense binary file
+   (of rows row_lo .. row_lo+row_n-1): a file view selects them from each row, and 
+   MPI_File_read_at_all() reads at most 1 GB of them at a time. */
+void readDenseColumns(MPI_File fh, int ws, MPI_Datatype wt)
+{
+    MPI_Datatype row, columns;
+    MPI_Type_contiguous(col_n, wt, &row);
+    MPI_Type_create_resized(row, 0, (MPI_Aint)NV*ws, &columns);
+    MPI_Type_commit(&columns);
+    MPI_File_set_view(fh, sizeof(struct graph_header) + ((MPI_Offset)row_lo*NV + col_lo)*ws, wt, columns, 
+                      "native", MPI_INFO_NULL);
+
+    int rows = col_n > 0 ? (1 << 30) / ((size_t)col_n*ws) : row_n; // rows per call
+    if (rows == 0) 
+        rows = 1;
+    int calls = (row_n + rows - 1) / rows, max_calls; // (every process makes the same number of calls)
+    MPI_Allreduce(&calls, &max_calls, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    int in_place = !sparse && ws == sizeof(WEIGHT);
+    unsigned char *buf = in_place ? NULL : xmalloc((size_t)rows*col_n*ws + 1);
+    if (sparse)
+        first_edge = xmalloc((NV + 1)*sizeof(uint64_t));
+    else {
+        edges = alloc_edges(row_n, col_n);
+        first_touch(edges, row_n, col_n);
+    }
+    NE = 0;
+
+    for (int k = 0; k < max_calls; k++) { // (rows r0 .. r1-1 of our rows)
+        int r0 = k*rows < row_n ? k*rows : row_n, r1 = r0 + rows < row_n ? r0 + rows : row_n;
+        int n = (r1 - r0)*col_n;
+        void *to = in_place ? (void *)(edges + (size_t)r0*col_n) : (void *)buf;
+        MPI_File_read_at_all(fh, (MPI_Offset)r0*col_n, to, n, wt, MPI_STATUS_IGNORE);
+        if (in_place)
+            continue;
+        for (int i = r0; i < r1; i++) {
+            for (int j = 0; j < col_n; j++) {
+                unsigned int w = binary_weight(buf, ws, (uint64_t)(i - r0)*col_n + j);
+                if (sparse) {
+                    if (w < INFINITY)
+                        add_edge(col_lo + j, w);
+                } else {
+                    if (!weight_fits(w)) {
+                        fprintf(stderr, "binary graph file: weight %u does not fit in %d bits\n", w, WEIGHT_BITS);
+                        exit(2);
+                    }
+                    edges[(size_t)i*col_n + j] = dense_weight(w);
+                }
+            }
+            if (sparse)
+                first_edge[i+1] = NE;
+        }
+    }
+    if (sparse)
+        first_edge[0] = 0;
+    free(buf);
+    MPI_Type_free(&columns);
+    MPI_Type_free(&row);
+}
+
+/* (readGraphParallel) a CSR binary file: each process reads the edges of its own block
+   of rows (the edges *from* its vertices) and sends every edge to the process of the
+   vertex it goes to (MPI_Alltoallv). The edges each process receives are the ones
+   distributeSparseGraph() would give it, in the same order. */
+void readCSRRows(MPI_File fh, const struct graph_header *h, int ws, MPI_Datatype wt)
+{
+    VERTEX lo = block_start(rank), hi = block_start(rank+1);
+    const MPI_Offset to_at = sizeof(*h) + (MPI_Offset)(NV + 1)*sizeof(uint64_t);
+    const MPI_Offset weight_at = to_at + (MPI_Offset)h->ne*sizeof(VERTEX);
+    uint64_t *first = xmalloc((hi - lo + 1)*sizeof(uint64_t));
+    read_at_big(fh, sizeof(*h) + (MPI_Offset)lo*sizeof(uint64_t), first, hi - lo + 1, MPI_UINT64_T, sizeof(uint64_t));
+    for (VERTEX i = lo; i < hi; i++)
+        if (first[i - lo] > first[i - lo + 1]) {
+            fprintf(stderr, "binary graph file: bad CSR offsets (vertex %u)\n", i);
+            exit(2);
+        }
+    if (first[hi - lo] > h->ne) {
+        fprintf(stderr, "binary graph file: bad CSR offsets\n");
+        exit(2);
+    }
+    uint64_t e0 = first[0], n = first[hi - lo] - e0;
+    VERTEX *to = xmalloc(n*sizeof(VERTEX) + 1);
+    unsigned char *weight = xmalloc(n*ws + 1);
+    read_at_big(fh, to_at + e0*sizeof(VERTEX), to, n, MPI_UNSIGNED, sizeof(VERTEX));
+    read_at_big(fh, weight_at + e0*ws, weight, n, wt, ws);
+
+    // the edges (from, to, weight) for each process, in the order of the rows
+    int *send_count = calloc(nprocs, sizeof(int)), *send_start = xmalloc(nprocs*sizeof(int));
+    int *recv_count = xmalloc(nprocs*sizeof(int)), *recv_start = xmalloc(nprocs*sizeof(int));
+    if (send_count == NULL) { perror("calloc"); exit(1); }
+    for (uint64_t e = 0; e < n; e++) {
+        if (to[e] >= NV) {
+            fprintf(stderr, "binary graph file: bad vertex %u\n", to[e]);
+            exit(2);
+        }
+        send_count[block_owner(to[e])]++;
+    }
+    MPI_Alltoall(send_count, 1, MPI_INT, recv_count, 1, MPI_INT, MPI_COMM_WORLD);
+    long long total = 0;
+    for (int r = 0; r < nprocs; r++) {
+        send_start[r] = r > 0 ? send_start[r-1] + send_count[r-1] : 0;
+        recv_start[r] = total;
+        total += recv_count[r];
+    }
+    if (total > 0x7fffffff) {
+        fprintf(stderr, "process %d: too many edges to its vertices (%lld)\n", rank, total);
+        exit(1);
+    }
+    unsigned int (*out)[3] = xmalloc(n*sizeof(*out) + 1), (*in)[3] = xmalloc(total*sizeof(*in) + 1);
+    int *at = xmalloc(nprocs*sizeof(int));
+    memcpy(at, send_start, nprocs*sizeof(int));
+    for (VERTEX i = lo; i < hi; i++)
+        for (uint64_t e = first[i - lo] - e0; e < first[i - lo + 1] - e0; e++) {
+            int r = block_owner(to[e]);
+            out[at[r]][0] = i;
+            out[at[r]][1] = to[e];
+            out[at[r]][2] = binary_weight(weight, ws, e);
+            at[r]++;
+        }
+    free(first); free(to); free(weight); free(at);
+    MPI_Datatype triple;
+    MPI_Type_contiguous(3, MPI_UNSIGNED, &triple);
+    MPI_Type_commit(&triple);
+    MPI_Alltoallv(out, send_count, send_start, triple, in, recv_count, recv_start, triple, MPI_COMM_WORLD);
+    MPI_Type_free(&triple);
+    free(out); free(send_count); free(send_start); free(recv_count); free(recv_start);
+
+    // the edges arrive by rows (the blocks of rows of the processes are in order)
+    NE = total;
+    first_edge = calloc(NV + 1, sizeof(uint64_t));
+    edge_to = xmalloc(NE*sizeof(VERTEX) + 1);
+    edge_weight = xmalloc(NE*sizeof(unsigned int) + 1);
+    if (first_edge == NULL) { perror("calloc"); exit(1); }
+    for (uint64_t e = 0; e < NE; e++) {
+        first_edge[in[e][0] + 1]++;
+        edge_to[e] = in[e][1];
+        edge_weight[e] = in[e][2];
+    }
+    for (int i = 0; i < NV; i++)
+        first_edge[i+1] += first_edge[i];
+    free(in);
+}
+#endif
+
+/* (-i file, MPI) If 'input_file' is a binary graph file, every process reads only its
+   own part of the graph with MPI-IO (and sets NV, col_lo and col_n, as distributeGraph()
+   does): its columns of a dense graph (all of them in batch mode), or the edges to its
+   vertices of a CSR graph. Returns 0 if it did not read the graph (a text input, 
+   one process, or a CSR file in batch mode): then process 0 reads it. */
+int readGraphParallel()
+{
+#ifdef USE_MPI
+    if (input_file == NULL || nprocs == 1)
+        return 0;
+    MPI_File fh;
+    if (MPI_File_open(MPI_COMM_WORLD, input_file, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        if (rank == 0) fprintf(stderr, "%s: can not open\n", input_file);
+        exit(1);
+    }
+    struct graph_header h;
+    MPI_Offset size;
+    memset(&h, 0, sizeof(h));
+    MPI_File_get_size(fh, &size);
+    MPI_File_read_at_all(fh, 0, &h, size < (MPI_Offset)sizeof(h) ? 0 : sizeof(h), MPI_BYTE, MPI_STATUS_IGNORE);
+    if (memcmp(h.magic, "DJKG", 4) != 0 || (h.layout == GRAPH_CSR && batch)) {
+        MPI_File_close(&fh);
+        return 0;
+    }
+    int ws = h.weight_size;
+    if (h.version != 1 || (h.layout != GRAPH_DENSE && h.layout != GRAPH_CSR) ||
+        (ws != 1 && ws != 2 && ws != 4) || h.nv > 0x7fffffff) {
+        if (rank == 0) fprintf(stderr, "binary graph file: unknown version, layout or weight size\n");
+        exit(2);
+    }
+    NV = h.nv;
+    partition();
+    MPI_Datatype wt = ws == 1 ? MPI_UNSIGNED_CHAR : ws == 2 ? MPI_UNSIGNED_SHORT : MPI_UNSIGNED;
+    // the bytes after the header (the counts of the header are compared by dividing it,
+    // they may overflow a multiplication)
+    uint64_t rest = size - sizeof(h);
+    if (h.layout == GRAPH_DENSE) {
+        if ((uint64_t)NV*NV > rest / ws) {
+            if (rank == 0) fprintf(stderr, "binary graph file is truncated (expecting %" PRIu64 " weights)\n", (uint64_t)NV*NV);
+            exit(6);
+        }
+        readDenseColumns(fh, ws, wt);
+    } else {
+        if (rest < (NV + 1)*sizeof(uint64_t) || h.ne > (rest - (NV + 1)*sizeof(uint64_t)) / (sizeof(VERTEX) + ws)) {
+            if (rank == 0) fprintf(stderr, "binary graph file is truncated (expecting %" PRIu64 " edges)\n", h.ne);
+            exit(6);
+        }
+        sparse = 1;
+        readCSRRows(fh, &h, ws, wt);
+    }
+    MPI_File_close(&fh);
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+uint64_t max_edges; // (CSR) number of edges 'edge_to' and 'edge_weight' have room for
+
+/* append an edge ? -> j with weight w to 'edge_to' and 'edge_weight' */
+void add_edge(VERTEX j, unsigned int w)
+{
+    if (NE == max_edges) {
+        max_edges = max_edges ? 2*max_edges : 1024;
+        edge_to = (VERTEX *)realloc(edge_to, max_edges*sizeof(VERTEX));
+        edge_weight = (unsigned int *)realloc(edge_weight, max_edges*sizeof(unsigned int));
+        if (edge_to == NULL || edge_weight == NULL) { perror("realloc"); exit(1); }
+    }
+    edge_to[NE] = j;
+    edge_weight[NE] = w;
+    NE++;
+}
+
+/*  Read a sparse graph (the leading 's' has already been read):
+        nv ne
+    followed by ne triples  i j w: an edge i -> j with weight w.
+    The edges may appear in any order. Initialize 'NV', 'first_edge', 'edge_to' and 'edge_weight'.
+*/
+void readEdgeList()
+{
+    uint64_t nv, ne;
+    uint64_t i, j, w;
+
+    skip_white_space();
+    int ok = read_number(&nv, 0x7fffffff);
+    skip_white_space();
+    if (!ok || !read_number(&ne, UINT64_MAX)) {
+        fprintf(stderr, 
+                "line %d: 's' should be followed by the number of vertices and the number of edges\n",
+                lineno);
+        exit(1);
+    }
+    NV = nv;
+    sparse = 1;
+    VERTEX *from = (VERTEX *)malloc(ne*sizeof(VERTEX) + 1);
+    first_edge = (uint64_t *)calloc(NV + 1, sizeof(uint64_t));
+    if (from == NULL || first_edge == NULL) { perror("malloc"); exit(1); }
+
+    for (uint64_t e = 0; e < ne; e++) {
+        skip_white_space();
+        ok = read_number(&i, UINT32_MAX);
+        skip_white_space();
+        ok = ok && read_number(&j, UINT32_MAX);
+        skip_white_space();
+        if (!ok || !read_number(&w, UINT32_MAX)) {
+            fprintf(stderr, "line %d: error in input (expecting %" PRIu64 " edges)\n", lineno, ne);
+            exit(2);
+        }
+        if (i >= NV || j >= NV) {
+            fprintf(stderr, "line %d: illegal vertex in edge %" PRIu64 " -> %" PRIu64 "\n", lineno, i, j);
+            exit(2);
+        }
+        if (w >= INFINITY)  // not an edge
+            continue;
+        from[NE] = i;
+        add_edge(j, w);
+        first_edge[i+1]++;
+    }
+    skip_white_space();
+    if (peek_char() != EOF) {
+        fprintf(stderr, "line %d: too many edges (expecting %" PRIu64 " edges)\n", lineno, ne);
+        exit(5);
+    }
+
+    // sort the edges by their first vertex (counting sort)
+    for (int v = 0; v < NV; v++)
+        first_edge[v+1] += first_edge[v];
+    uint64_t *next = (uint64_t *)malloc(NV*sizeof(uint64_t) + 1);
+    VERTEX *to = (VERTEX *)malloc(NE*sizeof(VERTEX) + 1);
+    unsigned int *weight = (unsigned int *)malloc(NE*sizeof(unsigned int) + 1);
+    if (next == NULL || to == NULL || weight == NULL) { perror("malloc"); exit(1); }
+    memcpy(next, first_edge, NV*sizeof(uint64_t));
+    for (uint64_t e = 0; e < NE; e++) {
+        uint64_t k = next[from[e]]++;
+        to[k] = edge_to[e];
+        weight[k] = edge_weight[e];
+    }
+    free(from); free(next); free(edge_to); free(edge_weight);
+    edge_to = to;
+    edge_weight = weight;
 }
     
 void skip_white_space() {
    int c;
    while(1) {
-       if ((c = getchar()) == '\n')
+       if ((c = peek_char()) == '\n')
            lineno++;
-       else if (isspace(c))
-           continue;
-       else if (c == EOF)
-           break;
-       else {
-         ungetc(c, stdin); // push non space character back onto input stream
-         break;
-       }
+       else if (c == EOF || !isspace(c))
+           break;       // leave non space character in the input
+       in_pos++;
    }
 }
 
 void printDistances(char *s) 
 {  
-   if (s) printf("%s\n", s);
+   fprintDistances(stdout, s, distance);
+}
 
-   for (VERTEX v = 0; v < NV; v++)
-       if (distance[v] >= INFINITY)
-           printf("%u:*\n", v);
+/* The distances are not written with one printf() per vertex: the lines "v:d" of
+   OUT_CHUNK vertices at a time are formatted (with utoa()) into a buffer and written
+   with one fwrite(). The chunks are formatted by the threads in parallel and written 
+   in order. */
+#define OUT_CHUNK 65536 // vertices per buffer
+#define MAX_LINE 22     // the longest line: 10 digits, ':', 10 digits, '\n'
+
+/* write the decimal digits of x at p; returns the end of the digits */
+static inline char *utoa(char *p, unsigned int x)
+{
+   char digits[10];
+   int n = 0;
+   do {
+       digits[n++] = '0' + x % 10;
+       x /= 10;
+   } while (x != 0);
+   while (n > 0)
+       *p++ = digits[--n];
+   return p;
+}
+
+/* format the lines of vertices lo .. hi-1 (whose distances are dist[v-first]; with -r
+   the vertices are those of the input and the distance of v is dist[new_id[v]-first]) 
+   into 'buf' (room for (hi-lo)*MAX_LINE characters); returns the number of characters */
+size_t format_distances(char *buf, const unsigned int *dist, VERTEX first, VERTEX lo, VERTEX hi)
+{
+   char *p = buf;
+   for (VERTEX v = lo; v < hi; v++) {
+       unsigned int d = dist[renumbered(v) - first];
+       p = utoa(p, v);
+       *p++ = ':';
+       if (d >= INFINITY)
+           *p++ = '*';
        else
-           printf("%u:%u\n", v, distance[v]);
+           p = utoa(p, d);
+       *p++ = '\n';
+   }
+   return p - buf;
+}
+
+void fprintDistances(FILE *f, const char *s, const unsigned int *dist)
+{
+   if (s) fprintf(f, "%s\n", s);
+
+   long chunks = (NV + OUT_CHUNK - 1) / OUT_CHUNK;
+   int chunk = NV < OUT_CHUNK ? NV : OUT_CHUNK;
+#pragma omp parallel if(chunks > 1)
+ {
+   char *buf = xmalloc((size_t)chunk*MAX_LINE);
+#pragma omp for ordered schedule(static, 1)
+   for (long c = 0; c < chunks; c++) {
+       VERTEX lo = c*OUT_CHUNK, hi = lo + chunk < NV ? lo + chunk : NV;
+       size_t n = format_distances(buf, dist, 0, lo, hi);
+#pragma omp ordered
+       fwrite(buf, 1, n, f);
+   }
+   free(buf);
+ }
+}
+
+/* (-o) write the distances to 'output_file' (as text, or with -b as NV 32-bit numbers:
+   the array 'distance'). Every process writes its own vertices; with MPI they
+   are written with MPI_File_write_at_all() (collectively, each process at its
+   own offset) so that process 0 does not have to gather them. (With -r they are 
+   gathered first and process 0 writes them all.) */
+void writeDistances()
+{
+   size_t size;
+   char *buf;
+   VERTEX own_lo = block_start(rank), own_hi = block_start(rank+1); // (our block of 'distance')
+   if (new_id) // (gathered by process 0)
+       own_lo = 0, own_hi = rank == 0 ? NV : 0;
+   if (binary_output) {
+       size = (size_t)(own_hi - own_lo)*sizeof(unsigned int);
+       buf = (char *)distance;
+       if (new_id) {
+           unsigned int *d = xmalloc(size + 1);
+#pragma omp parallel for
+           for (VERTEX v = own_lo; v < own_hi; v++)
+               d[v] = distance[new_id[v]];
+           buf = (char *)d;
+       }
+   } else {
+       // format the chunks in parallel, each at its own place, then join them
+       long chunks = (own_hi - own_lo + OUT_CHUNK - 1) / OUT_CHUNK;
+       size_t *length = xmalloc((chunks + 1)*sizeof(size_t));
+       buf = xmalloc((size_t)(own_hi - own_lo)*MAX_LINE + 1);
+#pragma omp parallel for schedule(dynamic, 1)
+       for (long c = 0; c < chunks; c++) {
+           VERTEX lo = own_lo + c*OUT_CHUNK, hi = lo + OUT_CHUNK < own_hi ? lo + OUT_CHUNK : own_hi;
+           length[c] = format_distances(buf + (size_t)c*OUT_CHUNK*MAX_LINE, distance, own_lo, lo, hi);
+       }
+       size = 0;
+       for (long c = 0; c < chunks; c++) {
+           memmove(buf + size, buf + (size_t)c*OUT_CHUNK*MAX_LINE, length[c]);
+           size += length[c];
+       }
+       free(length);
+   }
+#ifdef USE_MPI
+   MPI_File fh;
+   unsigned long long my_size = size, offset = 0, total;
+   MPI_Exscan(&my_size, &offset, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+   MPI_Allreduce(&my_size, &total, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+   if (rank == 0)
+       offset = 0; // (MPI_Exscan leaves it undefined)
+   if (MPI_File_open(MPI_COMM_WORLD, output_file, MPI_MODE_CREATE | MPI_MODE_WRONLY, 
+                     MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+       if (rank == 0) fprintf(stderr, "%s: can not open\n", output_file);
+       exit(1);
+   }
+   MPI_File_set_size(fh, total);
+   /* the count of MPI_File_write_at_all() is an int: write at most 1 GB at a time
+      (every process makes the same number of calls, since they are collective) */
+   const size_t piece = 1 << 30;
+   unsigned long long pieces = (size + piece - 1) / piece, max_pieces;
+   MPI_Allreduce(&pieces, &max_pieces, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, MPI_COMM_WORLD);
+   for (unsigned long long k = 0; k < max_pieces; k++) {
+       size_t at = k*piece < size ? k*piece : size;
+       int n = size - at < piece ? size - at : piece;
+       MPI_File_write_at_all(fh, offset + at, buf + at, n, MPI_BYTE, MPI_STATUS_IGNORE);
+   }
+   MPI_File_close(&fh);
+#else
+   FILE *f = fopen(output_file, "wb");
+   if (f == NULL || fwrite(buf, 1, size, f) != size || fclose(f) != 0) {
+       perror(output_file);
+       exit(1);
+   }
+#endif
+   if (!binary_output || new_id)
+       free(buf);
 }
 
 // can be used for debugging
 void printGraph() {
 
     printf("graph weights:\n");
+    if (sparse) {
+        for (int i = 0; i < NV; i++)  {
+            for (uint64_t e = first_edge[i]; e < first_edge[i+1]; e++)
+                printf("%u->%u:%u  ", i, edge_to[e], edge_weight[e]);
+            putchar('\n');
+        }
+        return;
+    }
     for (int i = 0; i < NV; i++)  {
         for (int j = 0; j < NV; j++)
-            if (edges[NV*i+j] >= INFINITY)
+            if (weight_value(edges[NV*i+j]) >= INFINITY)
                 printf("*  ");
             else 
                 printf("%u  ", edges[NV*i+j]);
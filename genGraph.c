@@ -1,11 +1,26 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
 
 /*  Generate file with a description of a random graph
     in the format of exercise 2  summer of 2023.
     
     The file is written to the standard output. 
 
+    The weights are not taken from one random sequence: the weight of the edge i -> j
+    is a hash (SplitMix64) of the seed, i and j. So the rows can be generated in any
+    order, in parallel, and the output for a given seed is always the same.
+    OpenMP version: compile with -fopenmp. The rows are generated and formatted by
+    all the threads, a block of rows at a time, and each block is written with one write.
+    MPI version: compile with mpicc -DUSE_MPI (may be combined with -fopenmp); the 
+    output must then be a file (-o). Each process generates a contiguous block of rows
+    and writes it at its place in the file (MPI-IO).
+
     command line arguments (all of them are numbers):
       number of vertices 
       maximum weight of an edge
@@ -20,69 +35,699 @@
 
       Note: no edges with INFINITY weight are generated (except from
             each node to itself). This may be considered a bug.
+            (Use -t to generate graphs with fewer edges.)
+
+    options:
+      -b        write a binary graph file (see struct graph_header) instead of text.
+                dijkstra reads it (mapped into memory) much faster than text.
+      -w size   (with -b) bytes per weight: 1, 2 or 4 (the default).
+                Weights of 4 bytes can be used by dijkstra without being converted.
+      -o file   write to 'file' instead of the standard output.
+      -s        write the graph as a list of edges (s nv ne, followed by ne lines i j w),
+                or with -b in CSR layout. The graph is written directly in this form;
+                use it for sparse graphs (a dense row of NV weights is never built).
+      -t family the kind of graph:
+                uniform     every edge i -> j (i != j) exists (the default)
+                er          Erdos-Renyi: each edge exists with probability 'density'
+                rmat        R-MAT (Kronecker) power law graph with degree*NV edges
+                            (some are dropped: self loops and repeated edges)
+                grid        2D grid (like a road map): edges between neighbours, both ways
+                components  'components' separate Erdos-Renyi graphs (vertex 0 can
+                            not reach the vertices of the other components)
+      -d density   (er, components) probability of each edge.
+                   Default: degree/(number of possible neighbours).
+      -k degree    (er, components, rmat) average number of edges per vertex (default 8).
+      -c components  (components) number of components (default 4).
+
+      example: genGraph -t rmat -k 16 -s -b 1000000 100 > rmat.bin
+
+      example: genGraph -b 10000 20 7 > graph.bin
       
 */
+
+/* Binary graph file (all numbers little endian):
+     struct graph_header
+     layout GRAPH_DENSE: NV*NV weights (row by row)
+     layout GRAPH_CSR:   NV+1 first_edge (8 bytes each), NE edge_to (4 bytes each),
+                         NE weights
+   Weights are 'weight_size' bytes. A weight of 4 bytes is INFINITY ('*') if it is
+   INFINITY or more; a weight of 1 or 2 bytes is INFINITY if it is 0xff or 0xffff.
+   (dijkstra.c has the same definition.) */
+struct graph_header {
+    char magic[4];        // "DJKG"
+    uint8_t version;      // 1
+    uint8_t layout;       // GRAPH_DENSE or GRAPH_CSR
+    uint8_t weight_size;  // 1, 2 or 4
+    uint8_t unused1;
+    uint32_t nv;          // number of vertices
+    uint32_t unused2;
+    uint64_t ne;          // (GRAPH_CSR) number of edges
+    uint64_t unused3;
+};
+#define GRAPH_DENSE 0
+#define GRAPH_CSR   1
+
+#ifdef _OPENMP
+#include <omp.h>
+#else
+static inline int omp_get_thread_num() { return 0; }
+static inline int omp_get_num_threads() { return 1; }
+#endif
+
+const unsigned int INFINITY = 1000000; /* a large number.
+        if edge has this weight it means the edge does not exist.  */
+
+int NV;                // number of vertices
+int max_weight = 10;
+uint64_t seed = 1;
+int binary = 0;        // 1: write a binary graph file
+int weight_size = 4;   // (binary) bytes per weight
+int sparse = 0;        // 1: write a list of edges (text) or CSR layout (binary)
+
+enum family { UNIFORM, ER, RMAT, GRID, COMPONENTS } family = UNIFORM;
+const char *family_name[] = { "uniform", "er", "rmat", "grid", "components" };
+#define NUM_FAMILIES (sizeof(family_name)/sizeof(family_name[0]))
+
+double density = 0;    // (er, components) 0: degree / (number of possible neighbours)
+double degree = 8;     // (er, components, rmat) average number of edges per vertex
+int components = 4;    // (components)
+int grid_width;        // (grid) number of columns; the vertices are numbered row by row
+
+int rank = 0, nprocs = 1;
+int first_row, last_row; // this process generates rows first_row .. last_row-1
+
+#define BLOCK_BYTES (64 << 20)  // rows are generated and written in blocks of about this size
+
+/* SplitMix64: a good 64 bit hash (used as a counter based random number generator) */
+static inline uint64_t splitmix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/* a random number in (0,1): the k'th in the sequence identified by 'key' */
+static inline double random_fraction(uint64_t key, uint64_t k)
+{
+    return ((splitmix64(key + k) >> 11) + 0.5) / 9007199254740992.0; // 2^53
+}
+
+/* the weight of the edge i -> j (in a graph with the given seed and max_weight).
+   (dijkstra.c has the same function, for generating a graph in place.) */
+static inline unsigned int random_weight(uint64_t seed, int max_weight, int i, int j)
+{
+    if (i == j)
+        return INFINITY;
+    uint64_t row = splitmix64(seed ^ ((uint64_t)i << 32)); // each row has its own sequence
+    unsigned int w = splitmix64(row + j) % (max_weight + 1);
+    return w == 0 ? 1 : w; // weight should be positive
+}
+
+/* natural logarithm, for 0 < x <= 1. (Not taken from libm, so that a graph does not
+   depend on the C library: ln(x) = e*ln(2) + 2*atanh((m-1)/(m+1)) where x = m * 2^e, 1 <= m < 2) */
+static double ln(double x)
+{
+    int e = 0;
+    while (x < 1) { x *= 2; e--; }
+    double y = (x - 1) / (x + 1), y2 = y * y, term = y, sum = 0;
+    for (int k = 1; k < 40; k += 2) {
+        sum += term / k;
+        term *= y2;
+    }
+    return 2 * sum + e * 0.69314718055994530942;
+}
+
+struct edge {
+    uint32_t to;
+    uint32_t w;
+};
+
+/* Erdos-Renyi edges i -> j for j in lo .. hi-1 (j != i), each with probability p.
+   The gaps between the chosen j's are geometric, so the time is proportional to
+   the number of edges (not to hi-lo). Returns the number of edges added to 'row'. */
+int er_row(int i, int lo, int hi, double p, struct edge *row)
+{
+    int n = 0;
+    if (p >= 1) {
+        for (int j = lo; j < hi; j++)
+            if (j != i) 
+                row[n++] = (struct edge){ j, random_weight(seed, max_weight, i, j) };
+        return n;
+    }
+    if (p <= 0)
+        return 0;
+    uint64_t key = splitmix64(~seed ^ ((uint64_t)i << 32)); // a sequence for row i (not the weights' one)
+    double log_q = ln(1 - p);
+    long long j = lo - 1;
+    for (uint64_t k = 0; ; k++) {
+        j += 1 + (long long)(ln(random_fraction(key, k)) / log_q);
+        if (j >= hi)
+            break;
+        if (j != i)
+            row[n++] = (struct edge){ j, random_weight(seed, max_weight, i, j) };
+    }
+    return n;
+}
+
+/*  R-MAT: each edge is placed by choosing one of the four quadrants of the matrix
+    (with probabilities a, b, c, d) recursively, until a single entry is left.
+    The edges are generated here, and those of rows first_row .. last_row-1 are kept 
+    (in CSR form, each row sorted, without repeated edges).
+*/
+#define RMAT_A 0.57
+#define RMAT_B 0.19
+#define RMAT_C 0.19
+uint64_t *rmat_first;    // edges of row i: rmat_edges[rmat_first[i-first_row] .. rmat_first[i-first_row+1]-1]
+struct edge *rmat_edges;
+
+/* the e'th R-MAT edge (*from == *to means no edge) */
+void rmat_edge(uint64_t e, int *from, int *to)
+{
+    int levels = 0;
+    while ((1LL << levels) < NV)
+        levels++;
+    uint64_t key = splitmix64(seed * 0x9e3779b97f4a7c15ULL + e);
+    for (uint64_t attempt = 0; ; attempt++) { // (until the entry is inside the NV*NV matrix)
+        int i = 0, j = 0;
+        for (int l = 0; l < levels; l++) {
+            double u = random_fraction(key, attempt * levels + l);
+            i <<= 1; j <<= 1;
+            if (u >= RMAT_A + RMAT_B + RMAT_C) { i |= 1; j |= 1; }
+            else if (u >= RMAT_A + RMAT_B) i |= 1;
+            else if (u >= RMAT_A) j |= 1;
+        }
+        if (i < NV && j < NV) {
+            *from = i; *to = j;
+            return;
+        }
+    }
+}
+
+int compare_edges(const void *a, const void *b)
+{
+    const struct edge *x = a, *y = b;
+    return (x->to > y->to) - (x->to < y->to);
+}
+
+void generate_rmat()
+{
+    uint64_t ne = (uint64_t)(degree * NV);
+    int rows = last_row - first_row;
+    rmat_first = calloc(rows + 1, sizeof(uint64_t));
+    uint64_t *next = malloc((rows + 1) * sizeof(uint64_t));
+    if (rmat_first == NULL || next == NULL) { perror("malloc"); exit(1); }
+
+    // count the edges of our rows
+#pragma omp parallel for schedule(static)
+    for (uint64_t e = 0; e < ne; e++) {
+        int i, j;
+        rmat_edge(e, &i, &j);
+        if (i != j && i >= first_row && i < last_row)
+#pragma omp atomic
+            rmat_first[i - first_row + 1]++;
+    }
+    for (int r = 0; r < rows; r++)
+        rmat_first[r+1] += rmat_first[r];
+    memcpy(next, rmat_first, (rows + 1) * sizeof(uint64_t));
+    rmat_edges = malloc(rmat_first[rows] * sizeof(struct edge) + 1);
+    if (rmat_edges == NULL) { perror("malloc"); exit(1); }
+
+    // store them
+#pragma omp parallel for schedule(static)
+    for (uint64_t e = 0; e < ne; e++) {
+        int i, j;
+        rmat_edge(e, &i, &j);
+        if (i != j && i >= first_row && i < last_row) {
+            uint64_t k;
+#pragma omp atomic capture
+            k = next[i - first_row]++;
+            rmat_edges[k] = (struct edge){ j, random_weight(seed, max_weight, i, j) };
+        }
+    }
+
+    // sort each row and remove repeated edges (which have the same weight)
+    uint64_t n = 0;
+    for (int r = 0; r < rows; r++) {
+        uint64_t lo = rmat_first[r], hi = rmat_first[r+1];
+        qsort(rmat_edges + lo, hi - lo, sizeof(struct edge), compare_edges);
+        rmat_first[r] = n;
+        for (uint64_t k = lo; k < hi; k++)
+            if (k == lo || rmat_edges[k].to != rmat_edges[k-1].to)
+                rmat_edges[n++] = rmat_edges[k];
+    }
+    rmat_first[rows] = n;
+    free(next);
+}
+
+/* upper bound on the number of edges of a row */
+int max_degree()
+{
+    switch (family) {
+    case GRID:
+        return 4;
+    case RMAT: {
+        uint64_t m = 0;
+        for (int r = 0; r < last_row - first_row; r++)
+            if (rmat_first[r+1] - rmat_first[r] > m)
+                m = rmat_first[r+1] - rmat_first[r];
+        return (int)m; // (at most NV: the edges of a row go to different vertices)
+    }
+    default:
+        return NV;
+    }
+}
+
+/* the edges i -> ... of the graph, sorted by their second vertex.
+   Returns the number of edges in 'row'. */
+int get_row(int i, struct edge *row)
+{
+    int n = 0;
+    switch (family) {
+    case UNIFORM:
+        return er_row(i, 0, NV, 1, row);
+    case ER:
+        return er_row(i, 0, NV, density > 0 ? density : degree / (NV - 1), row);
+    case COMPONENTS: {
+        int c = (int)((long long)i * components / NV); // component of i
+        while ((long long)c * NV / components > i) c--;   // (rounding)
+        while ((long long)(c + 1) * NV / components <= i) c++;
+        int lo = (int)((long long)c * NV / components);
+        int hi = (int)((long long)(c + 1) * NV / components);
+        return er_row(i, lo, hi, density > 0 ? density : (hi - lo > 1 ? degree / (hi - lo - 1) : 0), row);
+    }
+    case GRID: {
+        int neighbour[4] = { i - grid_width, 
+                             i % grid_width > 0 ? i - 1 : -1, 
+                             (i + 1) % grid_width > 0 ? i + 1 : -1,
+                             i + grid_width };
+        for (int k = 0; k < 4; k++)
+            if (neighbour[k] >= 0 && neighbour[k] < NV)
+                row[n++] = (struct edge){ neighbour[k], random_weight(seed, max_weight, i, neighbour[k]) };
+        return n;
+    }
+    case RMAT: {
+        const uint64_t *first = rmat_first + (i - first_row);
+        n = first[1] - first[0];
+        memcpy(row, rmat_edges + first[0], n * sizeof(struct edge));
+        return n;
+    }
+    }
+    return 0;
+}
+
+/*  The output consists of a header followed by one or more parts; each part has a 
+    piece for each row:
+       text:               weights of the row ('*' when there is no edge), '\n'
+       text, sparse:       a line  i j w  for each edge of the row
+       binary:             weights of the row
+       binary, sparse:     part 0: first_edge[i] (and first_edge[NV] after the last row)
+                           part 1: edge_to of the edges of the row
+                           part 2: weights of the edges of the row
+*/
+int num_parts() 
+{
+    return binary && sparse ? 3 : 1;
+}
+
+uint64_t *row_first;  // first_edge[i] (in the CSR layout) for rows first_row .. last_row
+
+/* largest number of bytes the piece of a row (with n edges) may have */
+size_t max_piece(int part, int n)
+{
+    if (!binary)
+        return sparse ? (size_t)n * 30 : (size_t)NV * 9 + 1; // (weights have at most 7 digits)
+    if (!sparse)
+        return (size_t)NV * weight_size;
+    return part == 0 ? 16 : part == 1 ? (size_t)n * 4 : (size_t)n * weight_size;
+}
+
+static inline unsigned char *put_number(unsigned char *p, unsigned int x)
+{
+    unsigned char digits[10];
+    int n = 0;
+    do { digits[n++] = '0' + x % 10; x /= 10; } while (x > 0);
+    while (n > 0)
+        *p++ = digits[--n];
+    return p;
+}
+
+static inline unsigned char *put_weight(unsigned char *p, unsigned int w)
+{
+    if (weight_size == 1)
+        *p = (w == INFINITY) ? 0xff : w;
+    else if (weight_size == 2) {
+        uint16_t w2 = (w == INFINITY) ? 0xffff : w;
+        memcpy(p, &w2, 2);
+    } else 
+        memcpy(p, &w, 4);
+    return p + weight_size;
+}
+
+/* write the piece of row i (whose edges are row[0..n-1]) into 'buf'. 
+   Returns the number of bytes written.
+   Text rows are formatted as before: weights (or '*') followed by two spaces. */
+size_t format_piece(int part, int i, const struct edge *row, int n, unsigned char *buf)
+{
+    unsigned char *p = buf;
+    if (binary && sparse) {
+        if (part == 0) {
+            memcpy(p, &row_first[i - first_row], 8);
+            p += 8;
+            if (i == NV - 1) {
+                memcpy(p, &row_first[i - first_row + 1], 8);
+                p += 8;
+            }
+        } else 
+            for (int k = 0; k < n; k++)
+                if (part == 1) {
+                    memcpy(p, &row[k].to, 4);
+                    p += 4;
+                } else
+                    p = put_weight(p, row[k].w);
+    } else if (sparse) { // text: i j w
+        for (int k = 0; k < n; k++) {
+            p = put_number(p, i);
+            *p++ = ' ';
+            p = put_number(p, row[k].to);
+            *p++ = ' ';
+            p = put_number(p, row[k].w);
+            *p++ = '\n';
+        }
+    } else { // a dense row 
+        int k = 0;
+        for (int j = 0; j < NV; j++) {
+            unsigned int w = INFINITY;
+            if (k < n && row[k].to == (uint32_t)j)
+                w = row[k++].w;
+            if (binary)
+                p = put_weight(p, w);
+            else {
+                if (w == INFINITY)
+                    *p++ = '*';
+                else 
+                    p = put_number(p, w);
+                *p++ = ' ';
+                *p++ = ' ';
+            }
+        }
+        if (!binary)
+            *p++ = '\n';
+    }
+    return p - buf;
+}
+
+#ifdef USE_MPI
+MPI_File out_file;
+#else
+FILE *out_file;
+#endif
+
+struct buffer {
+    unsigned char *p;
+    size_t n, room;
+};
+
+/* make room for 'more' bytes in b */
+void reserve(struct buffer *b, size_t more)
+{
+    if (b->n + more > b->room) {
+        b->room = 2 * (b->n + more);
+        b->p = realloc(b->p, b->room);
+        if (b->p == NULL) { perror("realloc"); exit(1); }
+    }
+}
+
+/* Generate the pieces of 'part' for rows first .. last-1, a block of rows at a time
+   (the rows of a block are divided among the threads; each thread formats its rows
+   into its own buffer and the buffers are written in order).
+   If 'write' is 0 nothing is written; the number of bytes is returned.
+   The MPI version writes the block at 'offset' in the file, and every process 
+   must call this function with the same number of blocks ('blocks'). */
+long long write_part(int part, int first, int last, int rows_per_block, int blocks, long long offset, int write)
+{
+    int maxdeg = max_degree();
+    long long total = 0;
+    int nthreads = 1;
+#pragma omp parallel
+#pragma omp single
+    nthreads = omp_get_num_threads();
+    struct buffer *bufs = calloc(nthreads, sizeof(struct buffer));
+    if (bufs == NULL) { perror("malloc"); exit(1); }
+
+    for (int b = 0; b < blocks; b++) {
+        int lo = first + b * rows_per_block;
+        int hi = lo + rows_per_block;
+        if (hi > last) hi = last;
+
+#pragma omp parallel
+     {
+        int t = omp_get_thread_num(), nt = omp_get_num_threads();
+        struct buffer *buf = &bufs[t];
+        struct edge *row = malloc((maxdeg + 1) * sizeof(struct edge));
+        if (row == NULL) { perror("malloc"); exit(1); }
+        buf->n = 0;
+        // this thread's rows (contiguous, so the buffers can be written one after another)
+        long long n = hi > lo ? hi - lo : 0;
+        int my_lo = lo + n * t / nt, my_hi = lo + n * (t + 1) / nt;
+        for (int i = my_lo; i < my_hi; i++) {
+            int deg = (part == 0 && binary && sparse) ? 0 : get_row(i, row);
+            reserve(buf, max_piece(part, deg));
+            buf->n += format_piece(part, i, row, deg, buf->p + buf->n);
+        }
+        free(row);
+     }
+        size_t size = 0;
+        for (int t = 1; t < nthreads; t++) { // one buffer for the block
+            reserve(&bufs[0], bufs[t].n);
+            memcpy(bufs[0].p + bufs[0].n, bufs[t].p, bufs[t].n);
+            bufs[0].n += bufs[t].n;
+        }
+        size = bufs[0].n;
+        total += size;
+        if (!write)
+            continue;
+#ifdef USE_MPI
+        MPI_File_write_at_all(out_file, offset, bufs[0].p, size, MPI_BYTE, MPI_STATUS_IGNORE);
+        offset += size;
+#else
+        (void)offset;
+        if (size > 0 && fwrite(bufs[0].p, 1, size, out_file) != size) { perror("write"); exit(1); }
+#endif
+    }
+    for (int t = 0; t < nthreads; t++)
+        free(bufs[t].p);
+    free(bufs);
+    return total;
+}
+
+void usage(char *prog)
+{
+    if (rank == 0)
+        fprintf(stderr, "Usage: %s [-b [-w 1|2|4]] [-s] [-o file] [-t uniform|er|rmat|grid|components]\n"
+                        "       [-d density] [-k degree] [-c components] <number of vertices> [max-weight] [seed]\n", prog);
+    exit(1);
+}
+
 int main(int argc, char **argv) 
 {
+    char *out_name = NULL;   // NULL: the standard output
 
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <number of vertices> [max-weight] [seed]\n", argv[0]);
-        return 1;
+#ifdef USE_MPI
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+#endif
+
+    int opt;
+    while ((opt = getopt(argc, argv, "bw:o:st:d:k:c:")) != -1) {
+        switch (opt) {
+        case 'b':
+            binary = 1;
+            break;
+        case 'o':
+            out_name = optarg;
+            break;
+        case 's':
+            sparse = 1;
+            break;
+        case 'w':
+            weight_size = atoi(optarg);
+            if (weight_size != 1 && weight_size != 2 && weight_size != 4)
+                usage(argv[0]);
+            break;
+        case 't':
+            for (family = 0; family < NUM_FAMILIES; family++)
+                if (strcmp(optarg, family_name[family]) == 0)
+                    break;
+            if (family == NUM_FAMILIES)
+                usage(argv[0]);
+            break;
+        case 'd':
+            density = atof(optarg);
+            if (density <= 0 || density > 1)
+                usage(argv[0]);
+            break;
+        case 'k':
+            degree = atof(optarg);
+            if (degree <= 0)
+                usage(argv[0]);
+            break;
+        case 'c':
+            components = atoi(optarg);
+            if (components < 1)
+                usage(argv[0]);
+            break;
+        default:
+            usage(argv[0]);
+        }
     }
 
-    int NV = atoi(argv[1]);
+    if (argc - optind < 1) 
+        usage(argv[0]);
+    argv += optind - 1;
+    argc -= optind - 1;
+
+    NV = atoi(argv[1]);
 
-    int max_weight;
     if (argc >= 3)
         max_weight = atoi(argv[2]);
-    else
-        max_weight = 10;
 
-
-    int seed;
     if (argc >= 4)
         seed = atoi(argv[3]);
-    else
-        seed = 1;
 
-    unsigned int *edges = (unsigned int *) malloc(NV*NV*sizeof(unsigned int));
+    if (binary && weight_size < 4 && max_weight >= (1 << (8*weight_size)) - 1) {
+        if (rank == 0)
+            fprintf(stderr, "max-weight %d does not fit in %d byte weights\n", max_weight, weight_size);
+        return 1;
+    }
+    if (max_weight < 1 || max_weight >= (int)INFINITY) {
+        if (rank == 0)
+            fprintf(stderr, "max-weight should be between 1 and %u\n", INFINITY - 1);
+        return 1;
+    }
+    if (NV < 1) 
+        usage(argv[0]);
+    if (components > NV)
+        components = NV;
+    grid_width = 1;
+    while ((long long)grid_width * grid_width < NV)
+        grid_width++;
+
+    // rows of this process
+    first_row = (int)((long long)rank * NV / nprocs);
+    last_row = (int)((long long)(rank + 1) * NV / nprocs);
+    int my_rows = last_row - first_row;
+
+    if (family == RMAT)
+        generate_rmat();
+
+    // the number of edges (needed only for sparse output)
+    uint64_t ne = 0;
+    if (sparse) {
+        row_first = malloc((my_rows + 1) * sizeof(uint64_t));
+        if (row_first == NULL) { perror("malloc"); return 1; }
+        row_first[0] = 0;
+#pragma omp parallel
+     {
+        struct edge *row = malloc((max_degree() + 1) * sizeof(struct edge));
+        if (row == NULL) { perror("malloc"); exit(1); }
+#pragma omp for schedule(dynamic, 64)
+        for (int i = first_row; i < last_row; i++)
+            row_first[i - first_row + 1] = get_row(i, row);
+        free(row);
+     }
+        for (int r = 0; r < my_rows; r++)
+            row_first[r+1] += row_first[r];
+        uint64_t mine = row_first[my_rows], before = 0;
+        ne = mine;
+#ifdef USE_MPI
+        MPI_Exscan(&mine, &before, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+        if (rank == 0) before = 0;
+        MPI_Allreduce(&mine, &ne, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+#endif
+        for (int r = 0; r <= my_rows; r++)
+            row_first[r] += before;
+    }
 
-    unsigned int INFINITY = 1000000; /* a large number.
-        if edge has this weight it means the edge does not exist.  */
-    
-    // generate a random graph
-    srand(seed);
-    for (int i = 0; i < NV; i++)  
-        for (int j = 0; j < NV; j++)  {
-             if (j == i) edges[i*NV+i] = INFINITY;
-             else  {
-                 int w = rand() % (max_weight+1);
-                 if (w == 0) w = 1; // weight should be positive
-                 edges[i*NV+j] = w;
-             }
-        }
-    
     //   write to the output
 
-    // first write number of vertices
-    printf("%d\n", NV);
+    // first the header: the number of vertices (text) or struct graph_header (binary)
+    unsigned char header[64];
+    size_t header_size;
+    if (binary) {
+        const uint16_t one = 1;
+        if (*(const uint8_t *)&one != 1) {
+            fprintf(stderr, "binary graph files can only be written on little endian machines\n");
+            return 1;
+        }
+        struct graph_header h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, "DJKG", 4);
+        h.version = 1;
+        h.layout = sparse ? GRAPH_CSR : GRAPH_DENSE;
+        h.weight_size = weight_size;
+        h.nv = NV;
+        h.ne = ne;
+        memcpy(header, &h, sizeof(h));
+        header_size = sizeof(h);
+    } else if (sparse)
+        header_size = sprintf((char *)header, "s %d %llu\n", NV, (unsigned long long)ne);
+    else
+        header_size = sprintf((char *)header, "%d\n", NV);
 
     //  then write the weights.
-    //  each row in the edges table  will appear in a separate line
+    //  (text) each row in the edges table  will appear in a separate line
+
+    size_t row_estimate = sparse ? 30 * (size_t)(family == UNIFORM ? NV : degree + 4) : max_piece(0, 0);
+    int rows_per_block = BLOCK_BYTES / (row_estimate + 1);
+    if (rows_per_block < 1) rows_per_block = 1;
+    int blocks = (my_rows + rows_per_block - 1) / rows_per_block;
+
+#ifdef USE_MPI
+    if (out_name == NULL) {
+        if (rank == 0)
+            fprintf(stderr, "the MPI version of %s needs an output file (-o)\n", argv[0]);
+        MPI_Finalize();
+        return 1;
+    }
+    MPI_File_delete(out_name, MPI_INFO_NULL); // (it may not exist)
+    if (MPI_File_open(MPI_COMM_WORLD, out_name, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL, &out_file) != MPI_SUCCESS) {
+        if (rank == 0)
+            fprintf(stderr, "cannot create %s\n", out_name);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (rank == 0)
+        MPI_File_write_at(out_file, 0, header, header_size, MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_Allreduce(MPI_IN_PLACE, &blocks, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+
+    long long part_start = header_size; // where the current part starts in the file
+    for (int part = 0; part < num_parts(); part++) {
+        // the place of our rows in the part: after the rows of the lower ranks
+        long long my_bytes = write_part(part, first_row, last_row, rows_per_block, blocks, 0, 0);
+        long long offset = 0, part_bytes;
+        MPI_Exscan(&my_bytes, &offset, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+        if (rank == 0) offset = 0;
+        MPI_Allreduce(&my_bytes, &part_bytes, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+        write_part(part, first_row, last_row, rows_per_block, blocks, part_start + offset, 1);
+        part_start += part_bytes;
+    }
 
-    for (int i = 0; i < NV; i++) {
-         for (int j = 0; j < NV; j++) {
-              unsigned int w = edges[i*NV+j];
-              if (w == INFINITY)
-                  printf("*  ");
-              else 
-                  printf("%d  ", w);
-         }
-         putchar('\n');
+    MPI_File_close(&out_file);
+    MPI_Finalize();
+#else
+    out_file = stdout;
+    if (out_name != NULL && (out_file = fopen(out_name, "wb")) == NULL) {
+        perror(out_name);
+        return 1;
     }
+    fwrite(header, 1, header_size, out_file);
+    for (int part = 0; part < num_parts(); part++)
+        write_part(part, first_row, last_row, rows_per_block, blocks, 0, 1);
+    if (fflush(out_file) != 0) { perror("write"); return 1; }
+#endif
 
     return 0;
 }
-   
-
-
+ 